@@ -0,0 +1,969 @@
+/**
+ * @file ConcurrentHashMap.h
+ * @author Jackson Brenneman
+ * @brief Hash maps safe to share between threads
+ * @date 2023-11-25
+ *
+ */
+
+#ifndef _CONCURRENT_HASH_MAP_H_
+#define _CONCURRENT_HASH_MAP_H_
+
+#include <atomic>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <shared_mutex>
+#include <tuple>
+#include <utility>
+
+#include "HashMap.h"
+#include "Pair.h"
+
+
+/* * * * * * * * * * * * * * * * * * * * * * * * *
+ *
+ *    ConcurrentUnorderedMap Class Declaration
+ *
+ * Splits keys over Shards independent
+ * UnorderedMaps by the high bits of their mixed
+ * hash. Each shard has its own reader-writer
+ * lock, padded with its map to a cache line so
+ * shards never share one, and rehashes on its
+ * own. Readers of a shard run together, writers
+ * only block their own shard. Values are never
+ * handed out by reference: find copies, and
+ * visit, cvisit and upsert run a function on the
+ * value while its shard is locked.
+ *
+ * * * * * * * * * * * * * * * * * * * * * * * * */
+
+template <typename Key, typename T, typename Hash = Hasher<Key>,
+          size_t Shards = 64, typename KeyEqual = std::equal_to<Key>>
+class ConcurrentUnorderedMap
+{
+    static_assert(Shards > 0 && (Shards & (Shards - 1)) == 0,
+                  "shard count must be a power of two");
+
+    typedef Pair<const Key, T> pair;
+    typedef UnorderedMap<Key, T, Hash, KeyEqual> map_type;
+
+    static constexpr size_t CacheLine = 64;
+    static constexpr unsigned ShardBits = std::countr_zero(Shards);
+
+    struct alignas(CacheLine) Shard
+    {
+        mutable std::shared_mutex lock;
+        map_type map;
+    };
+
+    Shard shards[Shards];
+    Hash h;
+
+public:
+    explicit ConcurrentUnorderedMap(size_t n = 0, const Hash& hs = Hash(),
+                                    const KeyEqual& e = KeyEqual());
+    ConcurrentUnorderedMap(const ConcurrentUnorderedMap&) = delete;
+    ~ConcurrentUnorderedMap() = default;
+
+    ConcurrentUnorderedMap& operator=(const ConcurrentUnorderedMap&) = delete;
+
+    // Sums the shards one at a time, exact only while no writer runs
+    size_t size() const;
+    bool empty() const { return size() == 0; }
+
+    // Readers, take a shared lock on one shard
+    bool find(const Key&, T&) const;
+    bool contains(const Key&) const;
+    template <typename Fn> bool cvisit(const Key&, Fn) const;
+    template <typename Fn> void for_each(Fn) const;
+
+    // Writers, take an exclusive lock on one shard at a time
+    bool insert(const pair&);
+    template <typename... Args> bool try_emplace(const Key&, Args&&...);
+    template <typename M> bool insert_or_assign(const Key&, M&&);
+    template <typename Fn> bool visit(const Key&, Fn);
+    template <typename Fn, typename... Args> bool upsert(const Key&, Fn, Args&&...);
+    size_t erase(const Key&);
+    template <typename Pred> size_t erase_if(Pred);
+    void clear();
+    void reserve(size_t);
+
+private:
+    // fmix64 so keys with weak hashes still spread over the shards
+    Shard& shard_for(const Key& k) { return shards[shard_index(h(k))]; }
+    const Shard& shard_for(const Key& k) const { return shards[shard_index(h(k))]; }
+
+    static size_t shard_index(size_t hash) noexcept {
+        if constexpr (Shards == 1)
+            return 0;
+        else {
+            uint64_t v = hash;
+            v ^= v >> 33;
+            v *= 0xFF51AFD7ED558CCDULL;
+            v ^= v >> 33;
+            return (size_t)(v >> (64 - ShardBits));
+        }
+    }
+};
+
+
+/**
+ * @brief Epoch based reclamation shared by every ConcurrentReadMap
+ *
+ * A thread inside a map operation publishes the global epoch it saw in a
+ * record of its own, padded to a cache line, with a plain store. Memory
+ * retired during epoch e is freed once the global epoch reaches e + 2, by
+ * which point every thread that could still reach it has left.
+ */
+class EpochDomain
+{
+public:
+    struct alignas(64) Record
+    {
+        std::atomic<uint64_t> active{0};    // epoch + 1 while inside, else 0
+        std::atomic<bool> inUse{true};
+        Record *next = nullptr;
+        unsigned depth = 0;                 // only touched by the owner
+    };
+
+    static EpochDomain& instance() { static EpochDomain domain; return domain; }
+
+    // Enter and leave an operation, nested calls only count once
+    Record* enter();
+    static void exit(Record*) noexcept;
+
+    uint64_t epoch() const noexcept { return global.load(std::memory_order_seq_cst); }
+    // Moves the epoch on if every thread inside an operation has seen it
+    void try_advance() noexcept;
+
+private:
+    std::atomic<uint64_t> global{1};
+    std::atomic<Record*> records{nullptr};  // never freed, reused by new threads
+
+    EpochDomain() = default;
+
+    Record* local();
+    Record* claim();
+};
+
+/**
+ * @brief Keeps the calling thread inside the current epoch for its scope
+ */
+class EpochGuard
+{
+    EpochDomain::Record *rec;
+
+public:
+    EpochGuard() : rec(EpochDomain::instance().enter()) {}
+    EpochGuard(const EpochGuard&) = delete;
+    ~EpochGuard() { EpochDomain::exit(rec); }
+
+    EpochGuard& operator=(const EpochGuard&) = delete;
+};
+
+/**
+ * @brief Lock-free stack of retired objects, each with a retiredNext
+ * link and the retiredEpoch it was retired in
+ */
+template <typename U>
+class RetireList
+{
+    std::atomic<U*> head{nullptr};
+    std::atomic<size_t> count{0};
+
+public:
+    RetireList() = default;
+    RetireList(const RetireList&) = delete;
+    ~RetireList();
+
+    RetireList& operator=(const RetireList&) = delete;
+
+    size_t size() const noexcept { return count.load(std::memory_order_relaxed); }
+    void push(U*, uint64_t) noexcept;
+    void collect(uint64_t) noexcept;
+
+private:
+    void push_chain(U*, U*) noexcept;
+};
+
+
+/* * * * * * * * * * * * * * * * * * * * * * * * *
+ *
+ *      ConcurrentReadMap Class Declaration
+ *
+ * Hash map for read-mostly tables. Lookups take
+ * no lock and do no atomic read-modify-write:
+ * they only load pointers and write the calling
+ * thread's own epoch record. Chains never change
+ * once published, so every write is one CAS on a
+ * bucket head. Inserts push a new head, and
+ * erase and assign copy the (short) part of the
+ * chain before their node. Growing publishes a
+ * table twice the size whose buckets start out
+ * NotReady. Each one is filled by freezing its
+ * old bucket (tagging the head so no CAS on it
+ * can succeed) and copying the nodes that map to
+ * it. Writers help fill the buckets they touch,
+ * and readers that find one NotReady read the
+ * frozen or still live old chain instead.
+ * Replaced nodes and tables are freed through
+ * EpochDomain.
+ *
+ * * * * * * * * * * * * * * * * * * * * * * * * */
+
+template <typename Key, typename T, typename Hash = Hasher<Key>,
+          typename KeyEqual = std::equal_to<Key>>
+class ConcurrentReadMap
+{
+    typedef Pair<const Key, T> pair;
+
+    struct cnode
+    {
+        size_t hash;
+        pair data;
+        cnode *next;                // fixed once the node is published
+        cnode *retiredNext;
+        uint64_t retiredEpoch;
+
+        template <typename... Args>
+        cnode(size_t hs, cnode *n, Args&&... args)
+            : hash(hs), data(std::forward<Args>(args)...), next(n),
+              retiredNext(nullptr), retiredEpoch(0) {}
+    };
+
+    struct Table
+    {
+        size_t mask;
+        Table *prev;                // table this one is filled from
+        std::atomic<Table*> next;
+        std::atomic<bool> complete;
+        std::atomic<cnode*> *buckets;
+        Table *retiredNext;
+        uint64_t retiredEpoch;
+
+        Table(size_t, Table*);
+        Table(const Table&) = delete;
+        ~Table() { delete[] buckets; }
+
+        Table& operator=(const Table&) = delete;
+    };
+
+    static constexpr size_t CacheLine = 64;
+    // Retired objects gathered before a writer tries to free some
+    static constexpr size_t CollectThreshold = 64;
+
+    // Read by every lookup, kept apart from anything writers store to
+    alignas(CacheLine) std::atomic<Table*> current;
+    Hash h;
+    KeyEqual eq;
+
+    alignas(CacheLine) std::atomic<size_t> _size;
+    std::mutex resizeLock;
+    RetireList<cnode> retiredNodes;
+    RetireList<Table> retiredTables;
+
+public:
+    explicit ConcurrentReadMap(size_t n = 16, const Hash& hs = Hash(),
+                               const KeyEqual& e = KeyEqual());
+    ConcurrentReadMap(const ConcurrentReadMap&) = delete;
+    ~ConcurrentReadMap();
+
+    ConcurrentReadMap& operator=(const ConcurrentReadMap&) = delete;
+
+    bool empty() const noexcept { return size() == 0; }
+    size_t size() const noexcept { return _size.load(std::memory_order_relaxed); }
+    size_t bucket_count() const noexcept
+        { return current.load(std::memory_order_acquire)->mask + 1; }
+
+    // Readers, lock-free and never store to shared memory
+    bool find(const Key&, T&) const;
+    bool contains(const Key&) const;
+    template <typename Fn> bool cvisit(const Key&, Fn) const;
+    template <typename Fn> void for_each(Fn) const;
+
+    // Writers, lock-free apart from the thread that grows the table
+    bool insert(const pair& p) { return try_emplace(p.first, p.second); }
+    template <typename... Args> bool try_emplace(const Key&, Args&&...);
+    template <typename M> bool insert_or_assign(const Key&, M&&);
+    size_t erase(const Key&);
+
+private:
+    static cnode* not_ready() noexcept { return reinterpret_cast<cnode*>(uintptr_t(2)); }
+    static bool frozen(cnode *p) noexcept { return reinterpret_cast<uintptr_t>(p) & 1; }
+    static cnode* strip(cnode *p) noexcept
+        { return reinterpret_cast<cnode*>(reinterpret_cast<uintptr_t>(p) & ~uintptr_t(1)); }
+
+    // fmix64, bucket index is the low bits
+    size_t hash_of(const Key& k) const {
+        uint64_t v = h(k);
+        v ^= v >> 33;
+        v *= 0xFF51AFD7ED558CCDULL;
+        v ^= v >> 33;
+        return (size_t)v;
+    }
+
+    cnode* search(cnode*, size_t, const Key&) const;
+    cnode* lookup(size_t, const Key&) const;
+    std::atomic<cnode*>& writable_bucket(size_t, cnode*&);
+    void help_copy(Table*, size_t);
+    cnode* copy_prefix(cnode*, cnode*, cnode*);
+    static void destroy_prefix(cnode*, cnode*) noexcept;
+    void retire_prefix(cnode*, cnode*) noexcept;
+    void after_write();
+    void finish_resize(Table*);
+    static void destroy_chains(Table*) noexcept;
+};
+
+
+
+
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *        ConcurrentUnorderedMap Class Definitions         *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+// Sizes every shard for its share of n elements
+template <typename Key, typename T, typename H, size_t S, typename E>
+ConcurrentUnorderedMap<Key,T,H,S,E>::ConcurrentUnorderedMap(size_t n, const H& hs, const E& e)
+    : h(hs) {
+    for(Shard& s : shards)
+        s.map = map_type(n / S + 1, hs, e);
+}
+
+template <typename Key, typename T, typename H, size_t S, typename E>
+size_t ConcurrentUnorderedMap<Key,T,H,S,E>::size() const {
+    size_t n = 0;
+    for(const Shard& s : shards) {
+        std::shared_lock<std::shared_mutex> guard(s.lock);
+        n += s.map.size();
+    }
+
+    return n;
+}
+
+// Copies the value for k into out, returns false if k is absent
+template <typename Key, typename T, typename H, size_t S, typename E>
+bool ConcurrentUnorderedMap<Key,T,H,S,E>::find(const Key& k, T& out) const {
+    const Shard& s = shard_for(k);
+    std::shared_lock<std::shared_mutex> guard(s.lock);
+    auto itr = s.map.find(k);
+    if(itr == s.map.cend())
+        return false;
+
+    out = itr->second;
+    return true;
+}
+
+template <typename Key, typename T, typename H, size_t S, typename E>
+bool ConcurrentUnorderedMap<Key,T,H,S,E>::contains(const Key& k) const {
+    const Shard& s = shard_for(k);
+    std::shared_lock<std::shared_mutex> guard(s.lock);
+    return s.map.count(k) != 0;
+}
+
+// Calls fn(const T&) on the value for k under a shared lock
+template <typename Key, typename T, typename H, size_t S, typename E>
+template <typename Fn>
+bool ConcurrentUnorderedMap<Key,T,H,S,E>::cvisit(const Key& k, Fn fn) const {
+    const Shard& s = shard_for(k);
+    std::shared_lock<std::shared_mutex> guard(s.lock);
+    auto itr = s.map.find(k);
+    if(itr == s.map.cend())
+        return false;
+
+    fn(itr->second);
+    return true;
+}
+
+// Calls fn(const pair&) on every element, one shard at a time
+template <typename Key, typename T, typename H, size_t S, typename E>
+template <typename Fn>
+void ConcurrentUnorderedMap<Key,T,H,S,E>::for_each(Fn fn) const {
+    for(const Shard& s : shards) {
+        std::shared_lock<std::shared_mutex> guard(s.lock);
+        for(auto itr = s.map.cbegin(); itr != s.map.cend(); ++itr)
+            fn(*itr);
+    }
+}
+
+// Returns true if p was inserted
+template <typename Key, typename T, typename H, size_t S, typename E>
+bool ConcurrentUnorderedMap<Key,T,H,S,E>::insert(const pair& p) {
+    Shard& s = shard_for(p.first);
+    std::unique_lock<std::shared_mutex> guard(s.lock);
+    return s.map.insert(p).second;
+}
+
+template <typename Key, typename T, typename H, size_t S, typename E>
+template <typename... Args>
+bool ConcurrentUnorderedMap<Key,T,H,S,E>::try_emplace(const Key& k, Args&&... args) {
+    Shard& s = shard_for(k);
+    std::unique_lock<std::shared_mutex> guard(s.lock);
+    return s.map.try_emplace(k, std::forward<Args>(args)...).second;
+}
+
+template <typename Key, typename T, typename H, size_t S, typename E>
+template <typename M>
+bool ConcurrentUnorderedMap<Key,T,H,S,E>::insert_or_assign(const Key& k, M&& obj) {
+    Shard& s = shard_for(k);
+    std::unique_lock<std::shared_mutex> guard(s.lock);
+    return s.map.insert_or_assign(k, std::forward<M>(obj)).second;
+}
+
+// Calls fn(T&) on the value for k under an exclusive lock
+template <typename Key, typename T, typename H, size_t S, typename E>
+template <typename Fn>
+bool ConcurrentUnorderedMap<Key,T,H,S,E>::visit(const Key& k, Fn fn) {
+    Shard& s = shard_for(k);
+    std::unique_lock<std::shared_mutex> guard(s.lock);
+    auto itr = s.map.find(k);
+    if(itr == s.map.end())
+        return false;
+
+    fn(itr->second);
+    return true;
+}
+
+/**
+ * Calls fn(T&) on the value for k, first inserting T(args...) if k is
+ * absent, all under one lock. Returns true if k was inserted.
+ */
+template <typename Key, typename T, typename H, size_t S, typename E>
+template <typename Fn, typename... Args>
+bool ConcurrentUnorderedMap<Key,T,H,S,E>::upsert(const Key& k, Fn fn, Args&&... args) {
+    Shard& s = shard_for(k);
+    std::unique_lock<std::shared_mutex> guard(s.lock);
+    auto ret = s.map.try_emplace(k, std::forward<Args>(args)...);
+    fn(ret.first->second);
+
+    return ret.second;
+}
+
+template <typename Key, typename T, typename H, size_t S, typename E>
+size_t ConcurrentUnorderedMap<Key,T,H,S,E>::erase(const Key& k) {
+    Shard& s = shard_for(k);
+    std::unique_lock<std::shared_mutex> guard(s.lock);
+    return s.map.erase(k);
+}
+
+// Removes elements satisfying pred, one shard at a time
+template <typename Key, typename T, typename H, size_t S, typename E>
+template <typename Pred>
+size_t ConcurrentUnorderedMap<Key,T,H,S,E>::erase_if(Pred pred) {
+    size_t removed = 0;
+    for(Shard& s : shards) {
+        std::unique_lock<std::shared_mutex> guard(s.lock);
+        removed += s.map.erase_if(pred);
+    }
+
+    return removed;
+}
+
+template <typename Key, typename T, typename H, size_t S, typename E>
+void ConcurrentUnorderedMap<Key,T,H,S,E>::clear() {
+    for(Shard& s : shards) {
+        std::unique_lock<std::shared_mutex> guard(s.lock);
+        s.map.clear();
+    }
+}
+
+// Sizes every shard for its share of n elements
+template <typename Key, typename T, typename H, size_t S, typename E>
+void ConcurrentUnorderedMap<Key,T,H,S,E>::reserve(size_t n) {
+    for(Shard& s : shards) {
+        std::unique_lock<std::shared_mutex> guard(s.lock);
+        s.map.reserve(n / S + 1);
+    }
+}
+
+
+
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *          EpochDomain and RetireList Definitions         *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+inline EpochDomain::Record* EpochDomain::enter() {
+    Record *r = local();
+    if(r->depth++ == 0) {
+        r->active.store(global.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+    }
+
+    return r;
+}
+
+inline void EpochDomain::exit(Record *r) noexcept {
+    if(--r->depth == 0)
+        r->active.store(0, std::memory_order_release);
+}
+
+inline void EpochDomain::try_advance() noexcept {
+    uint64_t e = global.load(std::memory_order_seq_cst);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    for(Record *r = records.load(std::memory_order_acquire); r != nullptr; r = r->next) {
+        uint64_t a = r->active.load(std::memory_order_seq_cst);
+        if(a != 0 && a != e + 1)
+            return;
+    }
+    global.compare_exchange_strong(e, e + 1);
+}
+
+// The calling thread's record, given back when the thread exits
+inline EpochDomain::Record* EpochDomain::local() {
+    struct Owner
+    {
+        Record *rec = nullptr;
+        ~Owner() { if(rec) rec->inUse.store(false, std::memory_order_release); }
+    };
+    thread_local Owner owner;
+
+    if(owner.rec == nullptr)
+        owner.rec = claim();
+
+    return owner.rec;
+}
+
+// Reuses a record left by an exited thread, else adds a new one
+inline EpochDomain::Record* EpochDomain::claim() {
+    for(Record *r = records.load(std::memory_order_acquire); r != nullptr; r = r->next) {
+        bool expected = false;
+        if(!r->inUse.load(std::memory_order_relaxed) &&
+           r->inUse.compare_exchange_strong(expected, true, std::memory_order_acquire))
+            return r;
+    }
+
+    Record *r = new Record;
+    Record *first = records.load(std::memory_order_relaxed);
+    do {
+        r->next = first;
+    } while(!records.compare_exchange_weak(first, r, std::memory_order_release,
+                                           std::memory_order_relaxed));
+
+    return r;
+}
+
+// Frees everything still retired, no thread may be using the owner
+template <typename U>
+RetireList<U>::~RetireList() {
+    U *u = head.load(std::memory_order_relaxed);
+    while(u != nullptr) {
+        U *next = u->retiredNext;
+        delete u;
+        u = next;
+    }
+}
+
+template <typename U>
+void RetireList<U>::push(U *u, uint64_t epoch) noexcept {
+    u->retiredEpoch = epoch;
+    push_chain(u, u);
+    count.fetch_add(1, std::memory_order_relaxed);
+}
+
+// Frees entries retired at least two epochs before epoch
+template <typename U>
+void RetireList<U>::collect(uint64_t epoch) noexcept {
+    U *u = head.exchange(nullptr, std::memory_order_acquire);
+    U *keep = nullptr, *keepLast = nullptr;
+    size_t freed = 0;
+    while(u != nullptr) {
+        U *next = u->retiredNext;
+        if(u->retiredEpoch + 2 <= epoch) {
+            delete u;
+            freed++;
+        }
+        else {
+            u->retiredNext = keep;
+            keep = u;
+            if(keepLast == nullptr)
+                keepLast = u;
+        }
+        u = next;
+    }
+    if(keep != nullptr)
+        push_chain(keep, keepLast);
+    count.fetch_sub(freed, std::memory_order_relaxed);
+}
+
+// Pushes the linked entries first..last
+template <typename U>
+void RetireList<U>::push_chain(U *first, U *last) noexcept {
+    U *old = head.load(std::memory_order_relaxed);
+    do {
+        last->retiredNext = old;
+    } while(!head.compare_exchange_weak(old, first, std::memory_order_release,
+                                        std::memory_order_relaxed));
+}
+
+
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *           ConcurrentReadMap Class Definitions           *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+// A table filled from p starts with every bucket NotReady
+template <typename Key, typename T, typename H, typename E>
+ConcurrentReadMap<Key,T,H,E>::Table::Table(size_t count, Table *p)
+    : mask(count - 1), prev(p), next(nullptr), complete(p == nullptr),
+      buckets(new std::atomic<cnode*>[count]), retiredNext(nullptr), retiredEpoch(0) {
+    cnode *fill = (p == nullptr) ? nullptr : not_ready();
+    for(size_t i = 0; i < count; i++)
+        buckets[i].store(fill, std::memory_order_relaxed);
+}
+
+template <typename Key, typename T, typename H, typename E>
+ConcurrentReadMap<Key,T,H,E>::ConcurrentReadMap(size_t n, const H& hs, const E& e)
+    : current(new Table(std::bit_ceil(n < 2 ? 2 : n), nullptr)), h(hs), eq(e), _size(0) {}
+
+// No other thread may be using the map
+template <typename Key, typename T, typename H, typename E>
+ConcurrentReadMap<Key,T,H,E>::~ConcurrentReadMap() {
+    Table *t = current.load(std::memory_order_relaxed);
+    // A resize cut short by an exception still owns the old table
+    if(!t->complete.load(std::memory_order_relaxed)) {
+        destroy_chains(t->prev);
+        delete t->prev;
+    }
+    destroy_chains(t);
+    delete t;
+}
+
+// Copies the value for k into out, returns false if k is absent
+template <typename Key, typename T, typename H, typename E>
+bool ConcurrentReadMap<Key,T,H,E>::find(const Key& k, T& out) const {
+    EpochGuard guard;
+    cnode *n = lookup(hash_of(k), k);
+    if(n == nullptr)
+        return false;
+
+    out = n->data.second;
+    return true;
+}
+
+template <typename Key, typename T, typename H, typename E>
+bool ConcurrentReadMap<Key,T,H,E>::contains(const Key& k) const {
+    EpochGuard guard;
+    return lookup(hash_of(k), k) != nullptr;
+}
+
+// Calls fn(const T&) on the value for k
+template <typename Key, typename T, typename H, typename E>
+template <typename Fn>
+bool ConcurrentReadMap<Key,T,H,E>::cvisit(const Key& k, Fn fn) const {
+    EpochGuard guard;
+    cnode *n = lookup(hash_of(k), k);
+    if(n == nullptr)
+        return false;
+
+    fn(static_cast<const T&>(n->data.second));
+    return true;
+}
+
+/**
+ * Calls fn(const pair&) on every element. Elements present for the whole
+ * call are visited once, ones added or removed meanwhile may not be.
+ */
+template <typename Key, typename T, typename H, typename E>
+template <typename Fn>
+void ConcurrentReadMap<Key,T,H,E>::for_each(Fn fn) const {
+    EpochGuard guard;
+    Table *t = current.load(std::memory_order_acquire);
+    for(size_t j = 0; j <= t->mask; j++) {
+        cnode *head = t->buckets[j].load(std::memory_order_acquire);
+        bool shared = false;
+        if(head == not_ready()) {
+            Table *p = t->prev;
+            head = p->buckets[j & p->mask].load(std::memory_order_acquire);
+            shared = true;
+        }
+        for(cnode *n = strip(head); n != nullptr; n = n->next)
+            if(!shared || (n->hash & t->mask) == j)
+                fn(static_cast<const pair&>(n->data));
+    }
+}
+
+// Inserts k with a value built from args if k is absent
+template <typename Key, typename T, typename H, typename E>
+template <typename... Args>
+bool ConcurrentReadMap<Key,T,H,E>::try_emplace(const Key& k, Args&&... args) {
+    EpochGuard guard;
+    size_t hash = hash_of(k);
+    cnode *n = nullptr;
+    for(;;) {
+        cnode *head;
+        std::atomic<cnode*>& slot = writable_bucket(hash, head);
+        if(search(head, hash, k) != nullptr) {
+            delete n;
+            return false;
+        }
+
+        if(n == nullptr)
+            n = new cnode(hash, head, std::piecewise_construct, std::forward_as_tuple(k),
+                          std::forward_as_tuple(std::forward<Args>(args)...));
+        else
+            n->next = head;
+        if(slot.compare_exchange_strong(head, n, std::memory_order_acq_rel,
+                                        std::memory_order_relaxed))
+            break;
+    }
+    _size.fetch_add(1, std::memory_order_relaxed);
+    after_write();
+
+    return true;
+}
+
+// Inserts k with obj or replaces its node, returns true if k was inserted
+template <typename Key, typename T, typename H, typename E>
+template <typename M>
+bool ConcurrentReadMap<Key,T,H,E>::insert_or_assign(const Key& k, M&& obj) {
+    EpochGuard guard;
+    size_t hash = hash_of(k);
+    cnode *n = new cnode(hash, nullptr, k, std::forward<M>(obj));
+    for(;;) {
+        cnode *head;
+        std::atomic<cnode*>& slot = writable_bucket(hash, head);
+        cnode *x = search(head, hash, k);
+        cnode *first = n;
+        if(x == nullptr)
+            n->next = head;
+        else {
+            n->next = x->next;
+            try {
+                first = copy_prefix(head, x, n);
+            }
+            catch(...) {
+                delete n;
+                throw;
+            }
+        }
+
+        if(slot.compare_exchange_strong(head, first, std::memory_order_acq_rel,
+                                        std::memory_order_relaxed)) {
+            if(x == nullptr)
+                _size.fetch_add(1, std::memory_order_relaxed);
+            else
+                retire_prefix(head, x);
+            after_write();
+            return x == nullptr;
+        }
+        destroy_prefix(first, n);
+    }
+}
+
+// Removes k if present, returns the number of elements removed
+template <typename Key, typename T, typename H, typename E>
+size_t ConcurrentReadMap<Key,T,H,E>::erase(const Key& k) {
+    EpochGuard guard;
+    size_t hash = hash_of(k);
+    for(;;) {
+        cnode *head;
+        std::atomic<cnode*>& slot = writable_bucket(hash, head);
+        cnode *x = search(head, hash, k);
+        if(x == nullptr)
+            return 0;
+
+        cnode *first = copy_prefix(head, x, x->next);
+        if(slot.compare_exchange_strong(head, first, std::memory_order_acq_rel,
+                                        std::memory_order_relaxed)) {
+            retire_prefix(head, x);
+            _size.fetch_sub(1, std::memory_order_relaxed);
+            after_write();
+            return 1;
+        }
+        destroy_prefix(first, x->next);
+    }
+}
+
+template <typename Key, typename T, typename H, typename E>
+auto ConcurrentReadMap<Key,T,H,E>::search(cnode *n, size_t hash, const Key& k) const
+-> cnode* {
+    while(n != nullptr && !(n->hash == hash && eq(n->data.first, k)))
+        n = n->next;
+
+    return n;
+}
+
+/**
+ * Node for k, caller must hold an EpochGuard. A NotReady bucket means
+ * its nodes are still only in the previous table, and a frozen one means
+ * they may have moved to the next; either way the old chain is current
+ * until the new bucket is filled.
+ */
+template <typename Key, typename T, typename H, typename E>
+auto ConcurrentReadMap<Key,T,H,E>::lookup(size_t hash, const Key& k) const -> cnode* {
+    Table *t = current.load(std::memory_order_acquire);
+    for(;;) {
+        cnode *head = t->buckets[hash & t->mask].load(std::memory_order_acquire);
+        if(head == not_ready()) {
+            Table *p = t->prev;
+            head = p->buckets[hash & p->mask].load(std::memory_order_acquire);
+            return search(strip(head), hash, k);
+        }
+        if(!frozen(head))
+            return search(head, hash, k);
+
+        Table *nt = t->next.load(std::memory_order_acquire);
+        if(nt->buckets[hash & nt->mask].load(std::memory_order_acquire) == not_ready())
+            return search(strip(head), hash, k);
+        t = nt;
+    }
+}
+
+// Bucket for hash in the current table and its head, filling it if needed
+template <typename Key, typename T, typename H, typename E>
+auto ConcurrentReadMap<Key,T,H,E>::writable_bucket(size_t hash, cnode *&head)
+-> std::atomic<cnode*>& {
+    for(;;) {
+        Table *t = current.load(std::memory_order_acquire);
+        size_t j = hash & t->mask;
+        head = t->buckets[j].load(std::memory_order_acquire);
+        if(head == not_ready())
+            help_copy(t, j);
+        else if(!frozen(head))
+            return t->buckets[j];
+    }
+}
+
+// Freezes the old bucket feeding bucket j of t and copies its nodes over
+template <typename Key, typename T, typename H, typename E>
+void ConcurrentReadMap<Key,T,H,E>::help_copy(Table *t, size_t j) {
+    if(t->buckets[j].load(std::memory_order_acquire) != not_ready())
+        return;
+
+    Table *p = t->prev;
+    std::atomic<cnode*>& src = p->buckets[j & p->mask];
+    cnode *head = src.load(std::memory_order_acquire);
+    while(!frozen(head)) {
+        cnode *tagged = reinterpret_cast<cnode*>(reinterpret_cast<uintptr_t>(head) | 1);
+        if(src.compare_exchange_weak(head, tagged, std::memory_order_acq_rel,
+                                     std::memory_order_acquire))
+            break;
+    }
+
+    cnode *copy = nullptr;
+    try {
+        for(cnode *n = strip(head); n != nullptr; n = n->next)
+            if((n->hash & t->mask) == j)
+                copy = new cnode(n->hash, copy, n->data);
+    }
+    catch(...) {
+        destroy_prefix(copy, nullptr);
+        throw;
+    }
+
+    cnode *expected = not_ready();
+    if(!t->buckets[j].compare_exchange_strong(expected, copy, std::memory_order_acq_rel,
+                                              std::memory_order_relaxed))
+        destroy_prefix(copy, nullptr);
+}
+
+// Copies of the nodes from first up to stop, the last one linked to tail
+template <typename Key, typename T, typename H, typename E>
+auto ConcurrentReadMap<Key,T,H,E>::copy_prefix(cnode *first, cnode *stop, cnode *tail)
+-> cnode* {
+    cnode *head = tail;
+    cnode **link = &head;
+    try {
+        for(cnode *n = first; n != stop; n = n->next) {
+            *link = new cnode(n->hash, tail, n->data);
+            link = &(*link)->next;
+        }
+    }
+    catch(...) {
+        destroy_prefix(head, tail);
+        throw;
+    }
+
+    return head;
+}
+
+// Frees unpublished nodes from first up to tail
+template <typename Key, typename T, typename H, typename E>
+void ConcurrentReadMap<Key,T,H,E>::destroy_prefix(cnode *first, cnode *tail) noexcept {
+    while(first != tail) {
+        cnode *next = first->next;
+        delete first;
+        first = next;
+    }
+}
+
+// Retires the unlinked nodes first through last
+template <typename Key, typename T, typename H, typename E>
+void ConcurrentReadMap<Key,T,H,E>::retire_prefix(cnode *first, cnode *last) noexcept {
+    uint64_t epoch = EpochDomain::instance().epoch();
+    for(;;) {
+        cnode *next = first->next;
+        retiredNodes.push(first, epoch);
+        if(first == last)
+            return;
+        first = next;
+    }
+}
+
+/**
+ * Doubles the table once there are more elements than buckets, and frees
+ * retired memory every CollectThreshold retirements. Only the writer that
+ * wins resizeLock grows, others carry on.
+ */
+template <typename Key, typename T, typename H, typename E>
+void ConcurrentReadMap<Key,T,H,E>::after_write() {
+    Table *t = current.load(std::memory_order_acquire);
+    if(!t->complete.load(std::memory_order_acquire) ||
+       _size.load(std::memory_order_relaxed) > t->mask + 1) {
+        std::unique_lock<std::mutex> lock(resizeLock, std::try_to_lock);
+        if(lock.owns_lock()) {
+            t = current.load(std::memory_order_acquire);
+            if(t->complete.load(std::memory_order_relaxed) &&
+               _size.load(std::memory_order_relaxed) > t->mask + 1) {
+                Table *n = new Table(2 * (t->mask + 1), t);
+                t->next.store(n, std::memory_order_release);
+                current.store(n, std::memory_order_release);
+                t = n;
+            }
+            if(!t->complete.load(std::memory_order_relaxed))
+                finish_resize(t);
+        }
+    }
+
+    if(retiredNodes.size() + retiredTables.size() >= CollectThreshold) {
+        EpochDomain& domain = EpochDomain::instance();
+        domain.try_advance();
+        uint64_t epoch = domain.epoch();
+        retiredNodes.collect(epoch);
+        retiredTables.collect(epoch);
+    }
+}
+
+// Fills every bucket of t, then retires the old table and its nodes
+template <typename Key, typename T, typename H, typename E>
+void ConcurrentReadMap<Key,T,H,E>::finish_resize(Table *t) {
+    for(size_t j = 0; j <= t->mask; j++)
+        help_copy(t, j);
+
+    Table *p = t->prev;
+    uint64_t epoch = EpochDomain::instance().epoch();
+    for(size_t i = 0; i <= p->mask; i++) {
+        cnode *n = strip(p->buckets[i].load(std::memory_order_acquire));
+        while(n != nullptr) {
+            cnode *next = n->next;
+            retiredNodes.push(n, epoch);
+            n = next;
+        }
+    }
+    retiredTables.push(p, epoch);
+    t->complete.store(true, std::memory_order_release);
+}
+
+// Frees every node in t, skipping buckets not yet filled
+template <typename Key, typename T, typename H, typename E>
+void ConcurrentReadMap<Key,T,H,E>::destroy_chains(Table *t) noexcept {
+    for(size_t i = 0; i <= t->mask; i++) {
+        cnode *n = t->buckets[i].load(std::memory_order_relaxed);
+        if(n != not_ready())
+            destroy_prefix(strip(n), nullptr);
+    }
+}
+
+
+#endif //_CONCURRENT_HASH_MAP_H_
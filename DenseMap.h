@@ -0,0 +1,398 @@
+/**
+ * @file DenseMap.h
+ * @author Jackson Brenneman
+ * @brief Insertion ordered hash map over a contiguous array of pairs
+ * @date 2023-11-27
+ *
+ */
+
+#ifndef _DENSE_MAP_H_
+#define _DENSE_MAP_H_
+
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <stdexcept>
+#include <tuple>
+#include <utility>
+
+#include "Hasher.h"
+#include "Pair.h"
+#include "Vector.h"
+
+
+/* * * * * * * * * * * * * * * * * * * * * * * * *
+ *
+ *          DenseMap Class Declaration
+ *
+ * Pairs live back to back in a Vector in the
+ * order they were inserted, so iterating is a
+ * walk over an array. A separate open addressing
+ * index (linear probing, Fibonacci hashing) maps
+ * keys to positions. Each index slot is 32 bits:
+ * the low log2(capacity) bits hold the position
+ * + 1 (0 marks an empty slot) and the bits above
+ * hold a slice of the key's hash, so most probes
+ * that would fail a key compare never touch the
+ * pair array. Erase moves the last pair into the
+ * hole and shifts the probe run back, leaving no
+ * tombstones, so erasing changes the order of the
+ * remaining pairs. Keys must not be modified
+ * through an iterator. Key and T must be default
+ * constructible. Holds at most 2^32 - 2 pairs.
+ * Default max load factor is 0.8.
+ *
+ * * * * * * * * * * * * * * * * * * * * * * * * */
+
+template <typename Key, typename T, typename Hash = Hasher<Key>,
+          typename KeyEqual = std::equal_to<Key>>
+class DenseMap
+{
+    typedef Pair<Key, T> pair;
+
+    static const size_t MinCapacity = 8;
+    static constexpr size_t MaxCapacity = size_t(1) << 32;
+    static constexpr uint32_t Empty = 0;
+
+    Vector<pair> entries;
+    uint32_t *index;
+    size_t capacity;
+    unsigned shift;
+    uint32_t posMask;       // slot bits holding position + 1
+    Hash h;
+    KeyEqual eq;
+    float _max_load_factor;
+
+public:
+    typedef typename Vector<pair>::iterator iterator;
+    typedef typename Vector<pair>::const_iterator const_iterator;
+
+    DenseMap() : DenseMap(0) {}
+    DenseMap(size_t n, const Hash& hs = Hash(), const KeyEqual& e = KeyEqual());
+    DenseMap(const DenseMap&);
+    DenseMap(DenseMap&&) noexcept;
+    ~DenseMap() { delete[] index; }
+
+    DenseMap& operator=(const DenseMap&);
+    DenseMap& operator=(DenseMap&&) noexcept;
+
+          iterator begin() noexcept { return entries.begin(); }
+    const_iterator begin() const noexcept { return entries.cbegin(); }
+    const_iterator cbegin() const noexcept { return entries.cbegin(); }
+          iterator end() noexcept { return entries.end(); }
+    const_iterator end() const noexcept { return entries.cend(); }
+    const_iterator cend() const noexcept { return entries.cend(); }
+
+    bool empty() const noexcept { return entries.empty(); }
+    size_t size() const noexcept { return entries.size(); }
+    // Pairs in iteration order, size() of them
+    const pair* data() const noexcept { return entries.data(); }
+
+    void clear();
+    Pair<iterator, bool> insert(const pair& p) { return emplace_unique(p.first, p); }
+    Pair<iterator, bool> insert(pair&& p) { return emplace_unique(p.first, std::move(p)); }
+    template <typename... Args> Pair<iterator, bool> try_emplace(const Key&, Args&&...);
+    iterator erase(iterator pos) { return erase(const_iterator(&*pos)); }
+    iterator erase(const_iterator);
+    size_t erase(const Key&);
+
+    T& operator[](const Key& k) { return try_emplace(k).first->second; }
+    iterator find(const Key&);
+    const_iterator find(const Key&) const;
+    size_t count(const Key& k) const { return (find_slot(k) != capacity) ? 1 : 0; }
+
+    size_t bucket_count() const noexcept { return capacity; }
+    float load_factor() const { return (float)size() / (float)capacity; }
+    float max_load_factor() const { return _max_load_factor; }
+    void max_load_factor(float);
+    void rehash(size_t);
+    void reserve(size_t);
+
+private:
+    // Fibonacci hashing, the home slot is the top bits of the product
+    uint64_t mixed(const Key& k) const { return (uint64_t)h(k) * 0x9E3779B97F4A7C15ULL; }
+    size_t home(uint64_t m) const noexcept { return (size_t)(m >> shift); }
+    // Low bits of the product, above the position bits
+    uint32_t tag(uint64_t m) const noexcept { return (uint32_t)m & ~posMask; }
+    size_t position(size_t slot) const noexcept { return (index[slot] & posMask) - 1; }
+    size_t next(size_t slot) const noexcept { return (slot + 1) & (capacity - 1); }
+
+    size_t find_slot(const Key& k) const { return find_slot(mixed(k), k); }
+    size_t find_slot(uint64_t, const Key&) const;
+    size_t slot_of(size_t) const;
+    template <typename... Args>
+    Pair<iterator, bool> emplace_unique(const Key&, Args&&...);
+    void place(uint64_t, size_t) noexcept;
+    void erase_slot(size_t);
+    void remove_slot(size_t);
+    void resize(size_t);
+
+    iterator make_iterator(size_t pos) noexcept { return iterator(entries.data() + pos); }
+    const_iterator make_const_iterator(size_t pos) const noexcept
+        { return const_iterator(entries.data() + pos); }
+};
+
+
+
+
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *               DenseMap Class Definitions                *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+template <typename Key, typename T, typename H, typename E>
+DenseMap<Key,T,H,E>::DenseMap(size_t n, const H& hs, const E& e)
+    : entries(0), index(nullptr), capacity(0), shift(64), posMask(0),
+      h(hs), eq(e), _max_load_factor(0.8f) {
+    reserve(n);
+}
+
+// Copy constructor, keeps the layout and order of other
+template <typename Key, typename T, typename H, typename E>
+DenseMap<Key,T,H,E>::DenseMap(const DenseMap& other)
+    : entries(other.entries), index(new uint32_t[other.capacity]),
+      capacity(other.capacity), shift(other.shift), posMask(other.posMask),
+      h(other.h), eq(other.eq), _max_load_factor(other._max_load_factor) {
+    std::copy(other.index, other.index + capacity, index);
+}
+
+// Move constructor, other is left empty with no index
+template <typename Key, typename T, typename H, typename E>
+DenseMap<Key,T,H,E>::DenseMap(DenseMap&& other) noexcept
+    : entries(std::move(other.entries)), index(other.index), capacity(other.capacity),
+      shift(other.shift), posMask(other.posMask), h(std::move(other.h)),
+      eq(std::move(other.eq)), _max_load_factor(other._max_load_factor) {
+    other.index = nullptr;
+    other.capacity = 0;
+}
+
+// Copy assignment
+template <typename Key, typename T, typename H, typename E>
+DenseMap<Key,T,H,E>& DenseMap<Key,T,H,E>::operator=(const DenseMap& other) {
+    if(this == &other)
+        return *this;
+
+    DenseMap temp(other);
+    *this = std::move(temp);
+
+    return *this;
+}
+
+// Move assignment
+template <typename Key, typename T, typename H, typename E>
+DenseMap<Key,T,H,E>& DenseMap<Key,T,H,E>::operator=(DenseMap&& other) noexcept {
+    if(this == &other)
+        return *this;
+
+    delete[] index;
+    entries = std::move(other.entries);
+    index = other.index;
+    capacity = other.capacity;
+    shift = other.shift;
+    posMask = other.posMask;
+    h = std::move(other.h);
+    eq = std::move(other.eq);
+    _max_load_factor = other._max_load_factor;
+
+    other.index = nullptr;
+    other.capacity = 0;
+
+    return *this;
+}
+
+// Removes every pair, keeps the index capacity
+template <typename Key, typename T, typename H, typename E>
+void DenseMap<Key,T,H,E>::clear() {
+    for(size_t i = 0; i < entries.size(); i++)
+        entries[i] = pair();
+    entries.clear();
+    std::fill(index, index + capacity, Empty);
+}
+
+// Appends k with a value built from args if k is absent
+template <typename Key, typename T, typename H, typename E>
+template <typename... Args>
+auto DenseMap<Key,T,H,E>::try_emplace(const Key& k, Args&&... args)
+-> Pair<iterator, bool> {
+    return emplace_unique(k, std::piecewise_construct, std::forward_as_tuple(k),
+                          std::forward_as_tuple(std::forward<Args>(args)...));
+}
+
+/**
+ * Moves the last pair into pos and returns an iterator to pos, which
+ * then holds that pair (or is end() if pos was last). Iterating on from
+ * the result visits every pair not yet visited.
+ */
+template <typename Key, typename T, typename H, typename E>
+auto DenseMap<Key,T,H,E>::erase(const_iterator pos) -> iterator {
+    size_t p = &*pos - entries.data();
+    erase_slot(slot_of(p));
+
+    return make_iterator(p);
+}
+
+// Erase pair with key k, return number of pairs erased
+template <typename Key, typename T, typename H, typename E>
+size_t DenseMap<Key,T,H,E>::erase(const Key& k) {
+    size_t slot = find_slot(k);
+    if(slot == capacity)
+        return 0;
+
+    erase_slot(slot);
+    return 1;
+}
+
+// Return iterator to key if found, else end()
+template <typename Key, typename T, typename H, typename E>
+auto DenseMap<Key,T,H,E>::find(const Key& k) -> iterator {
+    size_t slot = find_slot(k);
+    return (slot == capacity) ? end() : make_iterator(position(slot));
+}
+
+// Return const_iterator to key if found, else cend()
+template <typename Key, typename T, typename H, typename E>
+auto DenseMap<Key,T,H,E>::find(const Key& k) const -> const_iterator {
+    size_t slot = find_slot(k);
+    return (slot == capacity) ? cend() : make_const_iterator(position(slot));
+}
+
+// Kept in (0, 0.95]; linear probing degrades quickly past that
+template <typename Key, typename T, typename H, typename E>
+void DenseMap<Key,T,H,E>::max_load_factor(float ml) {
+    if(ml <= 0.0f || ml > 0.95f)
+        ml = 0.95f;
+    _max_load_factor = ml;
+
+    if(size() >= capacity * _max_load_factor)
+        rehash(0);
+}
+
+// Rebuilds the index with at least n slots, n > size() / max_load_factor()
+template <typename Key, typename T, typename H, typename E>
+void DenseMap<Key,T,H,E>::rehash(size_t n) {
+    size_t need = (size_t)(size() / max_load_factor()) + 1;
+    if(n < need)
+        n = need;
+    if(n < MinCapacity)
+        n = MinCapacity;
+    if(n > MaxCapacity)
+        throw std::length_error("DenseMap: too many elements");
+
+    resize(std::bit_ceil(n));
+}
+
+// Room for n pairs without growing the array or the index
+template <typename Key, typename T, typename H, typename E>
+void DenseMap<Key,T,H,E>::reserve(size_t n) {
+    entries.reserve(n);
+    rehash((size_t)std::ceil(n / max_load_factor()) + 1);
+}
+
+// Slot holding k, capacity if k is absent
+template <typename Key, typename T, typename H, typename E>
+size_t DenseMap<Key,T,H,E>::find_slot(uint64_t m, const Key& k) const {
+    if(capacity == 0)
+        return capacity;
+
+    uint32_t t = tag(m);
+    for(size_t i = home(m); ; i = next(i)) {
+        uint32_t s = index[i];
+        if(s == Empty)
+            return capacity;
+        if((s & ~posMask) == t && eq(entries[(s & posMask) - 1].first, k))
+            return i;
+    }
+}
+
+// Slot pointing at the pair in position pos
+template <typename Key, typename T, typename H, typename E>
+size_t DenseMap<Key,T,H,E>::slot_of(size_t pos) const {
+    size_t i = home(mixed(entries[pos].first));
+    while(position(i) != pos)
+        i = next(i);
+
+    return i;
+}
+
+/**
+ * Appends a pair built from args unless key is present. The index grows
+ * before the pair is added, so a throwing constructor leaves the map as
+ * it was apart from capacity.
+ */
+template <typename Key, typename T, typename H, typename E>
+template <typename... Args>
+auto DenseMap<Key,T,H,E>::emplace_unique(const Key& key, Args&&... args)
+-> Pair<iterator, bool> {
+    uint64_t m = mixed(key);
+    size_t slot = find_slot(m, key);
+    if(slot != capacity)
+        return Pair<iterator, bool>(make_iterator(position(slot)), false);
+
+    if(size() + 1 >= capacity * max_load_factor())
+        rehash(capacity * 2);
+    entries.push_back(pair(std::forward<Args>(args)...));
+    place(m, size() - 1);
+
+    return Pair<iterator, bool>(make_iterator(size() - 1), true);
+}
+
+// Records position pos for a key hashing to m in the first free slot
+template <typename Key, typename T, typename H, typename E>
+void DenseMap<Key,T,H,E>::place(uint64_t m, size_t pos) noexcept {
+    size_t i = home(m);
+    while(index[i] != Empty)
+        i = next(i);
+    index[i] = tag(m) | (uint32_t)(pos + 1);
+}
+
+// Removes the pair slot points at, filling its position with the last pair
+template <typename Key, typename T, typename H, typename E>
+void DenseMap<Key,T,H,E>::erase_slot(size_t slot) {
+    size_t pos = position(slot);
+    size_t last = size() - 1;
+    remove_slot(slot);
+    if(pos != last) {
+        size_t moved = slot_of(last);
+        index[moved] = (index[moved] & ~posMask) | (uint32_t)(pos + 1);
+        entries[pos] = std::move(entries[last]);
+    }
+    entries[last] = pair();
+    entries.pop_back();
+}
+
+/**
+ * Empties slot and pulls later members of its probe run back into the
+ * gap (Knuth's Algorithm R). A slot is only moved if its home does not lie
+ * cyclically between the gap and itself, so every key stays reachable.
+ */
+template <typename Key, typename T, typename H, typename E>
+void DenseMap<Key,T,H,E>::remove_slot(size_t slot) {
+    size_t gap = slot;
+    for(size_t i = next(slot); index[i] != Empty; i = next(i)) {
+        size_t r = home(mixed(entries[position(i)].first));
+        bool stays = (gap < i) ? (gap < r && r <= i) : (gap < r || r <= i);
+        if(stays)
+            continue;
+        index[gap] = index[i];
+        gap = i;
+    }
+    index[gap] = Empty;
+}
+
+// Rebuilds the index with cap slots, a power of two
+template <typename Key, typename T, typename H, typename E>
+void DenseMap<Key,T,H,E>::resize(size_t cap) {
+    uint32_t *slots = new uint32_t[cap]();
+    delete[] index;
+    index = slots;
+    capacity = cap;
+    shift = 64 - std::countr_zero(cap);
+    posMask = (uint32_t)(cap - 1);
+    for(size_t i = 0; i < size(); i++)
+        place(mixed(entries[i].first), i);
+}
+
+
+#endif //_DENSE_MAP_H_
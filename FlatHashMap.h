@@ -0,0 +1,590 @@
+/**
+ * @file FlatHashMap.h
+ * @author Jackson Brenneman
+ * @brief Open addressing hash table with SIMD probing
+ * @date 2023-11-18
+ *
+ */
+
+#ifndef _FLAT_HASHMAP_H_
+#define _FLAT_HASHMAP_H_
+
+#include <bit>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <iterator>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#include "Hasher.h"
+#include "Pair.h"
+
+
+/**
+ * @brief Sixteen control bytes probed together
+ *
+ * A control byte is Empty, Deleted, or the low 7 bits of a full slot's
+ * hash. Each match returns a bit mask with bit i set for byte i.
+ */
+struct CtrlGroup
+{
+    typedef signed char ctrl_t;
+
+    static constexpr ctrl_t Empty = -128;
+    static constexpr ctrl_t Deleted = -2;
+    static constexpr size_t Width = 16;
+
+#if defined(__SSE2__)
+    __m128i bytes;
+
+    explicit CtrlGroup(const ctrl_t *p)
+        : bytes(_mm_load_si128(reinterpret_cast<const __m128i*>(p))) {}
+
+    uint32_t match(ctrl_t h2) const {
+        return _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_set1_epi8(h2), bytes));
+    }
+    uint32_t match_empty() const { return match(Empty); }
+    uint32_t match_empty_or_deleted() const {
+        return _mm_movemask_epi8(_mm_cmpgt_epi8(_mm_set1_epi8(-1), bytes));
+    }
+#else
+    const ctrl_t *bytes;
+
+    explicit CtrlGroup(const ctrl_t *p) : bytes(p) {}
+
+    uint32_t match(ctrl_t h2) const {
+        uint32_t m = 0;
+        for(size_t i = 0; i < Width; i++)
+            if(bytes[i] == h2) m |= 1u << i;
+        return m;
+    }
+    uint32_t match_empty() const { return match(Empty); }
+    uint32_t match_empty_or_deleted() const {
+        uint32_t m = 0;
+        for(size_t i = 0; i < Width; i++)
+            if(bytes[i] < -1) m |= 1u << i;
+        return m;
+    }
+#endif
+};
+
+
+/* * * * * * * * * * * * * * * * * * * * * * * * *
+ *
+ *        FlatHashMap Class Declaration
+ *
+ * Drop in replacement for UnorderedMap using open
+ * addressing. Pairs are stored inline in one slot
+ * array, and a separate array of 1 byte control
+ * tags is probed one 16 byte group at a time, so
+ * most lookups touch one tag group and one slot.
+ * Capacity is a power of two, at least one group.
+ * Erased slots become Empty when their group still
+ * has an empty slot, otherwise Deleted tombstones
+ * that are dropped on the next rehash.
+ * Hashes with the seeded Hasher by default, so
+ * colliding keys cannot be worked out in advance.
+ *
+ * * * * * * * * * * * * * * * * * * * * * * * * */
+
+template <typename Key, typename T, typename Hash = Hasher<Key>>
+class FlatHashMap
+{
+    typedef Pair<const Key, T> pair;
+    typedef CtrlGroup::ctrl_t ctrl_t;
+
+    template <typename val_type>
+    class Flat_Iterator;
+
+    ctrl_t *ctrl;
+    pair *slots;
+    size_t capacity;
+    size_t currentSize;
+    size_t growthLeft;
+    Hash h;
+    float _max_load_factor;
+
+public:
+    typedef Flat_Iterator<pair> iterator;
+    typedef Flat_Iterator<const pair> const_iterator;
+
+    FlatHashMap() : FlatHashMap(0) {}
+    FlatHashMap(size_t n, const Hash& hs = Hash());
+    FlatHashMap(const FlatHashMap&);
+    FlatHashMap(FlatHashMap&&) noexcept;
+    ~FlatHashMap();
+
+    FlatHashMap& operator=(const FlatHashMap&);
+    FlatHashMap& operator=(FlatHashMap&&) noexcept;
+
+          iterator begin() noexcept { return iterator(ctrl, slots, ctrl + capacity); }
+    const_iterator begin() const noexcept { return cbegin(); }
+    const_iterator cbegin() const noexcept
+        { return const_iterator(ctrl, slots, ctrl + capacity); }
+          iterator end() noexcept { return make_iterator(capacity); }
+    const_iterator end() const noexcept { return cend(); }
+    const_iterator cend() const noexcept { return make_const_iterator(capacity); }
+
+    bool empty() const noexcept { return currentSize == 0; }
+    size_t size() const noexcept { return currentSize; }
+
+    void clear() noexcept;
+    Pair<iterator, bool> insert(const pair&);
+    Pair<iterator, bool> insert(pair&&);
+    iterator erase(const_iterator);
+    size_t erase(const Key&);
+
+    T& operator[](const Key&);
+    iterator find(const Key&);
+    const_iterator find(const Key&) const;
+    size_t count(const Key& k) const { return (find(k) != cend()) ? 1 : 0; }
+
+    size_t bucket_count() const noexcept { return capacity; }
+    float load_factor() const
+        { return capacity ? (float)currentSize / (float)capacity : 0.0f; }
+    float max_load_factor() const { return _max_load_factor; }
+    void max_load_factor(float);
+    void rehash(size_t);
+    void reserve(size_t n) { rehash(std::ceil(n / max_load_factor())); }
+
+private:
+    static size_t mix(size_t x) noexcept {
+        uint64_t v = x;
+        v ^= v >> 33;
+        v *= 0xFF51AFD7ED558CCDULL;
+        v ^= v >> 33;
+        return (size_t)v;
+    }
+    static ctrl_t h2(size_t hash) noexcept { return (ctrl_t)(hash & 0x7F); }
+    static size_t h1(size_t hash) noexcept { return hash >> 7; }
+
+    size_t growth_limit(size_t cap) const;
+    size_t find_index(const Key&, size_t hash) const;
+    size_t find_free(size_t hash) const;
+    template <typename... Args> size_t emplace_at(size_t hash, Args&&...);
+    template <typename P> Pair<iterator, bool> insert_pair(P&&);
+    void resize(size_t);
+    void destroy_all() noexcept;
+    void release() noexcept;
+
+    iterator make_iterator(size_t ndx) noexcept
+        { return iterator(ctrl + ndx, slots + ndx, ctrl + capacity); }
+    const_iterator make_const_iterator(size_t ndx) const noexcept
+        { return const_iterator(ctrl + ndx, slots + ndx, ctrl + capacity); }
+
+    template <typename val_type>
+    class Flat_Iterator
+    {
+    public:
+        typedef std::forward_iterator_tag iterator_category;
+        typedef std::remove_const_t<val_type> value_type;
+        typedef std::ptrdiff_t difference_type;
+        typedef val_type* pointer;
+        typedef val_type& reference;
+
+        Flat_Iterator() : ctrl(nullptr), slot(nullptr), last(nullptr) {}
+        template <typename V,
+                  typename = std::enable_if_t<std::is_convertible_v<V*, val_type*>>>
+        Flat_Iterator(const Flat_Iterator<V>& it)
+            : ctrl(it.ctrl), slot(it.slot), last(it.last) {}
+
+        reference operator*() const { return *slot; }
+        pointer operator->() const { return slot; }
+
+        Flat_Iterator& operator++() { ++ctrl; ++slot; skip(); return *this; }
+        Flat_Iterator operator++(int)
+            { Flat_Iterator temp = *this; ++(*this); return temp; }
+
+        bool operator==(const Flat_Iterator& rhs) const noexcept
+            { return ctrl == rhs.ctrl; }
+        bool operator!=(const Flat_Iterator& rhs) const noexcept
+            { return !(*this == rhs); }
+
+    private:
+        const ctrl_t *ctrl;
+        val_type *slot;
+        const ctrl_t *last;
+
+        Flat_Iterator(const ctrl_t *c, val_type *s, const ctrl_t *l)
+            : ctrl(c), slot(s), last(l) { skip(); }
+
+        // Advances to the next full slot or to the end
+        void skip() { while(ctrl != last && *ctrl < 0) { ++ctrl; ++slot; } }
+
+        template <typename> friend class Flat_Iterator;
+        friend class FlatHashMap;
+    };
+
+public:
+    template <typename F, typename G, typename I>
+    friend ostream& operator<<(ostream&, const FlatHashMap<F,G,I>&);
+};
+
+
+
+
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *             FlatHashMap Class Definitions               *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+// Constructor, room for at least n pairs before growing
+template <typename Key, typename T, typename H>
+FlatHashMap<Key,T,H>::FlatHashMap(size_t n, const H& hs)
+    : ctrl(nullptr), slots(nullptr), capacity(0), currentSize(0),
+      growthLeft(0), h(hs), _max_load_factor(0.875) {
+    if(n > 0)
+        reserve(n);
+}
+
+/**
+ * Copy constructor, keeps the layout of other. Deleted tombstones are
+ * copied too, since a key placed past a full group is only reached by
+ * probing through them.
+ */
+template <typename Key, typename T, typename H>
+FlatHashMap<Key,T,H>::FlatHashMap(const FlatHashMap& other)
+    : ctrl(nullptr), slots(nullptr), capacity(0), currentSize(0),
+      growthLeft(0), h(other.h), _max_load_factor(other._max_load_factor) {
+    if(other.capacity == 0)
+        return;
+
+    resize(other.capacity);
+    try {
+        for(size_t i = 0; i < other.capacity; i++) {
+            if(other.ctrl[i] < 0)
+                continue;
+            new (slots + i) pair(other.slots[i]);
+            ctrl[i] = other.ctrl[i];
+            currentSize++;
+        }
+    }
+    catch(...) {
+        destroy_all();
+        release();
+        throw;
+    }
+    std::memcpy(ctrl, other.ctrl, capacity);
+    growthLeft = other.growthLeft;
+}
+
+// Move constructor
+template <typename Key, typename T, typename H>
+FlatHashMap<Key,T,H>::FlatHashMap(FlatHashMap&& other) noexcept
+    : ctrl(other.ctrl), slots(other.slots), capacity(other.capacity),
+      currentSize(other.currentSize), growthLeft(other.growthLeft),
+      h(std::move(other.h)), _max_load_factor(other._max_load_factor) {
+    other.ctrl = nullptr;
+    other.slots = nullptr;
+    other.capacity = 0;
+    other.currentSize = 0;
+    other.growthLeft = 0;
+}
+
+template <typename Key, typename T, typename H>
+FlatHashMap<Key,T,H>::~FlatHashMap() {
+    destroy_all();
+    release();
+}
+
+// Copy assignment
+template <typename Key, typename T, typename H>
+FlatHashMap<Key,T,H>& FlatHashMap<Key,T,H>::operator=(const FlatHashMap& other) {
+    if(this == &other)
+        return *this;
+
+    FlatHashMap temp(other);
+    return *this = std::move(temp);
+}
+
+// Move assignment
+template <typename Key, typename T, typename H>
+FlatHashMap<Key,T,H>& FlatHashMap<Key,T,H>::operator=(FlatHashMap&& other) noexcept {
+    if(this == &other)
+        return *this;
+
+    destroy_all();
+    release();
+
+    ctrl = other.ctrl;
+    slots = other.slots;
+    capacity = other.capacity;
+    currentSize = other.currentSize;
+    growthLeft = other.growthLeft;
+    h = std::move(other.h);
+    _max_load_factor = other._max_load_factor;
+
+    other.ctrl = nullptr;
+    other.slots = nullptr;
+    other.capacity = 0;
+    other.currentSize = 0;
+    other.growthLeft = 0;
+
+    return *this;
+}
+
+// Destroys all pairs, capacity is kept
+template <typename Key, typename T, typename H>
+void FlatHashMap<Key,T,H>::clear() noexcept {
+    destroy_all();
+    if(capacity > 0)
+        std::memset(ctrl, CtrlGroup::Empty, capacity);
+    currentSize = 0;
+    growthLeft = growth_limit(capacity);
+}
+
+// Insert pair, return iterator to pair and bool if inserted
+template <typename Key, typename T, typename H>
+auto FlatHashMap<Key,T,H>::insert(const pair& p) -> Pair<iterator, bool> {
+    return insert_pair(p);
+}
+
+// Move insert
+template <typename Key, typename T, typename H>
+auto FlatHashMap<Key,T,H>::insert(pair&& p) -> Pair<iterator, bool> {
+    return insert_pair(std::move(p));
+}
+
+// Erase pair at itr, return iterator to the next pair
+template <typename Key, typename T, typename H>
+auto FlatHashMap<Key,T,H>::erase(const_iterator itr) -> iterator {
+    size_t ndx = itr.ctrl - ctrl;
+    slots[ndx].~pair();
+    currentSize--;
+
+    // A probe reaching this group stops here if it has an empty slot
+    size_t group = ndx & ~(CtrlGroup::Width - 1);
+    if(CtrlGroup(ctrl + group).match_empty()) {
+        ctrl[ndx] = CtrlGroup::Empty;
+        growthLeft++;
+    }
+    else
+        ctrl[ndx] = CtrlGroup::Deleted;
+
+    return make_iterator(ndx + 1);
+}
+
+// Erase pair with key k, return number of pairs erased
+template <typename Key, typename T, typename H>
+size_t FlatHashMap<Key,T,H>::erase(const Key& k) {
+    size_t ndx = find_index(k, mix(h(k)));
+    if(ndx == capacity)
+        return 0;
+
+    erase(make_const_iterator(ndx));
+    return 1;
+}
+
+// Subscript operator
+template <typename Key, typename T, typename H>
+T& FlatHashMap<Key,T,H>::operator[](const Key& k) {
+    size_t hash = mix(h(k));
+    size_t ndx = find_index(k, hash);
+    if(ndx == capacity)
+        ndx = emplace_at(hash, k, T());
+
+    return slots[ndx].second;
+}
+
+// Return iterator to key if found, else end()
+template <typename Key, typename T, typename H>
+auto FlatHashMap<Key,T,H>::find(const Key& k) -> iterator {
+    return make_iterator(find_index(k, mix(h(k))));
+}
+
+// Return const_iterator to key if found, else cend()
+template <typename Key, typename T, typename H>
+auto FlatHashMap<Key,T,H>::find(const Key& k) const -> const_iterator {
+    return make_const_iterator(find_index(k, mix(h(k))));
+}
+
+// Sets max load factor, capped at 7/8 so every probe meets an empty slot
+template <typename Key, typename T, typename H>
+void FlatHashMap<Key,T,H>::max_load_factor(float ml) {
+    if(ml <= 0.0f || ml > 0.875f)
+        ml = 0.875f;
+    _max_load_factor = ml;
+
+    if(currentSize > growth_limit(capacity))
+        rehash(0);
+    else if(capacity > 0)
+        rehash(capacity);
+}
+
+// Rehash to at least n slots, n > size() / max_load_factor()
+template <typename Key, typename T, typename H>
+void FlatHashMap<Key,T,H>::rehash(size_t n) {
+    size_t need = currentSize ? (size_t)std::ceil(currentSize / max_load_factor()) + 1 : 0;
+    if(n < need)
+        n = need;
+    if(n == 0 && currentSize == 0) {
+        destroy_all();
+        release();
+        return;
+    }
+    if(n < CtrlGroup::Width)
+        n = CtrlGroup::Width;
+
+    resize(std::bit_ceil(n));
+}
+
+// Number of pairs cap slots may hold, always leaves an empty slot
+template <typename Key, typename T, typename H>
+size_t FlatHashMap<Key,T,H>::growth_limit(size_t cap) const {
+    if(cap == 0)
+        return 0;
+
+    size_t limit = (size_t)(cap * _max_load_factor);
+    return limit < cap ? limit : cap - 1;
+}
+
+// Index of the slot holding k, or capacity if absent
+template <typename Key, typename T, typename H>
+size_t FlatHashMap<Key,T,H>::find_index(const Key& k, size_t hash) const {
+    if(capacity == 0)
+        return capacity;
+
+    size_t mask = capacity / CtrlGroup::Width - 1;
+    size_t group = h1(hash) & mask;
+    for(size_t step = 1; ; step++) {
+        size_t base = group * CtrlGroup::Width;
+        CtrlGroup g(ctrl + base);
+        for(uint32_t m = g.match(h2(hash)); m != 0; m &= m - 1) {
+            size_t ndx = base + std::countr_zero(m);
+            if(slots[ndx].first == k)
+                return ndx;
+        }
+        if(g.match_empty())
+            return capacity;
+        group = (group + step) & mask;    // triangular probing
+    }
+}
+
+// Index of the first empty or deleted slot on the probe path of hash
+template <typename Key, typename T, typename H>
+size_t FlatHashMap<Key,T,H>::find_free(size_t hash) const {
+    size_t mask = capacity / CtrlGroup::Width - 1;
+    size_t group = h1(hash) & mask;
+    for(size_t step = 1; ; step++) {
+        size_t base = group * CtrlGroup::Width;
+        uint32_t m = CtrlGroup(ctrl + base).match_empty_or_deleted();
+        if(m != 0)
+            return base + std::countr_zero(m);
+        group = (group + step) & mask;
+    }
+}
+
+// Constructs a new pair for a key known to be absent, returns its index
+template <typename Key, typename T, typename H>
+template <typename... Args>
+size_t FlatHashMap<Key,T,H>::emplace_at(size_t hash, Args&&... args) {
+    if(growthLeft == 0) {
+        // Mostly tombstones: rebuild in place, else double
+        if(capacity > 0 && currentSize <= growth_limit(capacity) / 2)
+            resize(capacity);
+        else
+            resize(capacity ? capacity * 2 : CtrlGroup::Width);
+    }
+
+    size_t ndx = find_free(hash);
+    new (slots + ndx) pair(std::forward<Args>(args)...);
+    if(ctrl[ndx] == CtrlGroup::Empty)
+        growthLeft--;
+    ctrl[ndx] = h2(hash);
+    currentSize++;
+
+    return ndx;
+}
+
+template <typename Key, typename T, typename H>
+template <typename P>
+auto FlatHashMap<Key,T,H>::insert_pair(P&& p) -> Pair<iterator, bool> {
+    size_t hash = mix(h(p.first));
+    size_t ndx = find_index(p.first, hash);
+    if(ndx != capacity)
+        return Pair<iterator, bool>(make_iterator(ndx), false);
+
+    ndx = emplace_at(hash, std::forward<P>(p));
+    return Pair<iterator, bool>(make_iterator(ndx), true);
+}
+
+// Moves every pair into a new table of cap slots, cap a power of two
+template <typename Key, typename T, typename H>
+void FlatHashMap<Key,T,H>::resize(size_t cap) {
+    ctrl_t *oldCtrl = ctrl;
+    pair *oldSlots = slots;
+    size_t oldCap = capacity;
+
+    ctrl = static_cast<ctrl_t*>(
+        ::operator new(cap, std::align_val_t(CtrlGroup::Width)));
+    try {
+        slots = static_cast<pair*>(
+            ::operator new(cap * sizeof(pair), std::align_val_t(alignof(pair))));
+    }
+    catch(...) {
+        ::operator delete(ctrl, std::align_val_t(CtrlGroup::Width));
+        ctrl = oldCtrl;
+        throw;
+    }
+    std::memset(ctrl, CtrlGroup::Empty, cap);
+    capacity = cap;
+
+    for(size_t i = 0; i < oldCap; i++) {
+        if(oldCtrl[i] < 0)
+            continue;
+        size_t hash = mix(h(oldSlots[i].first));
+        size_t ndx = find_free(hash);
+        new (slots + ndx) pair(std::move(oldSlots[i]));
+        ctrl[ndx] = h2(hash);
+        oldSlots[i].~pair();
+    }
+    size_t limit = growth_limit(capacity);
+    growthLeft = limit > currentSize ? limit - currentSize : 0;
+
+    if(oldCap > 0) {
+        ::operator delete(oldCtrl, std::align_val_t(CtrlGroup::Width));
+        ::operator delete(oldSlots, std::align_val_t(alignof(pair)));
+    }
+}
+
+// Destroys every pair without touching the control bytes
+template <typename Key, typename T, typename H>
+void FlatHashMap<Key,T,H>::destroy_all() noexcept {
+    if(!std::is_trivially_destructible_v<pair>) {
+        for(size_t i = 0; i < capacity; i++)
+            if(ctrl[i] >= 0)
+                slots[i].~pair();
+    }
+}
+
+// Frees both arrays, pairs must already be destroyed
+template <typename Key, typename T, typename H>
+void FlatHashMap<Key,T,H>::release() noexcept {
+    if(capacity > 0) {
+        ::operator delete(ctrl, std::align_val_t(CtrlGroup::Width));
+        ::operator delete(slots, std::align_val_t(alignof(pair)));
+    }
+    ctrl = nullptr;
+    slots = nullptr;
+    capacity = 0;
+    currentSize = 0;
+    growthLeft = 0;
+}
+
+
+template <typename F, typename G, typename I>
+ostream& operator<<(ostream &os, const FlatHashMap<F,G,I>& rhs) {
+    for(auto itr = rhs.cbegin(); itr != rhs.cend(); ++itr)
+        os << *itr;
+    return os;
+}
+
+
+#endif //_FLAT_HASHMAP_H_
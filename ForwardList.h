@@ -9,8 +9,13 @@
 #ifndef _FORWARD_LIST_H_
 #define _FORWARD_LIST_H_
 
+#include <cstddef>
 #include <stdexcept>
 #include <iostream>
+#include <iterator>
+#include <new>
+#include <type_traits>
+#include <utility>
 
 using std::logic_error;
 using std::invalid_argument;
@@ -27,6 +32,9 @@ struct Node
     Node() = default;
     Node(const T& d, Node *p = NULL) : data(d), next(p) {}
     Node(T&& d, Node *p = NULL) : data(std::move(d)), next(p) {}
+    template <typename... Args>
+    Node(std::in_place_t, Node *p, Args&&... args)
+        : data(std::forward<Args>(args)...), next(p) {}
     Node(const Node& rhs) = default;
     Node(Node&& rhs) = default;
 };
@@ -43,21 +51,25 @@ class ForwardList
     template <typename val_type = T, typename ptr_type = Node<T>*>
     class List_Iterator;
 
+    // Storage of a recycled node, payload already destroyed
+    struct Spare { Spare *next; };
+
     Node<T> *head;
     size_t _size;
+    Spare *cache;
 
 public:
     typedef List_Iterator<T, Node<T>*> iterator;
     typedef List_Iterator<const T, const Node<T>*> const_iterator;
 
-    ForwardList() : head(NULL), _size(0) {}
+    ForwardList() : head(NULL), _size(0), cache(NULL) {}
     ForwardList(size_t, const T& = T());
     ForwardList(const ForwardList&);
-    ForwardList(ForwardList&&) = default;
+    ForwardList(ForwardList&&) noexcept;
     ~ForwardList();
 
     ForwardList& operator=(const ForwardList&);
-    ForwardList& operator=(ForwardList&&) = default;
+    ForwardList& operator=(ForwardList&&) noexcept;
 
           T& front() { return head->data; }
     const T& front() const { return head->data; }
@@ -73,28 +85,48 @@ public:
     size_t size() const noexcept { return _size; }
     
     void clear() noexcept;
+    void clear_keep_nodes(size_t = static_cast<size_t>(-1)) noexcept;
+    void shrink_cache() noexcept;
     iterator insert_after(const_iterator, const T&);
     iterator insert_after(const_iterator, T&&);
+    template <typename... Args> iterator emplace_after(const_iterator, Args&&...);
     iterator erase_after(const_iterator);
     void push_front(const T&);
     void push_front(T&&);
+    template <typename... Args> T& emplace_front(Args&&...);
     void pop_front();
+    void splice_front(ForwardList&) noexcept;
 
     void remove(const T&);
+    template <typename Pred> size_t remove_if(Pred);
 
 private:
+    template <typename... Args> Node<T>* create_node(Node<T>*, Args&&...);
+
     template <typename val_type, typename ptr_type>
     class List_Iterator 
     {
     public:
+        typedef std::forward_iterator_tag iterator_category;
+        typedef std::remove_const_t<val_type> value_type;
+        typedef std::ptrdiff_t difference_type;
+        typedef val_type* pointer;
+        typedef val_type& reference;
+
+        List_Iterator() : current(NULL) {}
         List_Iterator(ptr_type ptr) { current = ptr; }
 
-        val_type& operator*() { return current->data; }
-        val_type* operator->() { return &(current->data); }
-        const val_type& operator*() const { return current->data; }
-        const val_type* operator->() const { return &(current->data); }
+        // iterator converts to const_iterator, not the other way
+        template <typename V, typename P,
+                  typename = std::enable_if_t<std::is_convertible_v<P, ptr_type>>>
+        List_Iterator(const List_Iterator<V, P>& it) { current = it.current; }
 
-        List_Iterator operator++() { current = current->next; return *this; }
+        reference operator*() const { return current->data; }
+        pointer operator->() const { return &(current->data); }
+
+        List_Iterator& operator++() { current = current->next; return *this; }
+        List_Iterator operator++(int)
+            { List_Iterator temp(current); current = current->next; return temp; }
 
         bool operator==(const List_Iterator &rhs) const noexcept 
             { return this->current == rhs.current; }
@@ -103,6 +135,9 @@ private:
 
     private:
         ptr_type current;
+
+        template <typename, typename> friend class List_Iterator;
+        friend class ForwardList;
     };
 
 public:
@@ -120,6 +155,7 @@ template <typename T>
 ForwardList<T>::ForwardList(size_t n, const T& val) {
     head = NULL;
     _size = 0;
+    cache = NULL;
 
     for(size_t i = 0; i < n; i++)
         push_front(val);
@@ -130,6 +166,7 @@ template <typename T>
 ForwardList<T>::ForwardList(const ForwardList& rhs) {
     head = NULL;
     _size = 0;
+    cache = NULL;
 
     auto itr = rhs.cbegin();
     while(itr != rhs.cend()) {
@@ -138,14 +175,26 @@ ForwardList<T>::ForwardList(const ForwardList& rhs) {
     }
 }
 
+// Move constructor
+template <typename T>
+ForwardList<T>::ForwardList(ForwardList&& rhs) noexcept {
+    head = rhs.head;
+    _size = rhs._size;
+    cache = rhs.cache;
+
+    rhs.head = NULL;
+    rhs._size = 0;
+    rhs.cache = NULL;
+}
+
 /** 
  * List Destructor
- * Calls the clear method for list deletion
+ * Calls the clear method for list deletion, then frees cached nodes
  */
 template <typename T>
 ForwardList<T>::~ForwardList() {
     clear();
-    delete head;
+    shrink_cache();
 }
 
 // Overloaded assignment copy
@@ -165,6 +214,26 @@ ForwardList<T>& ForwardList<T>::operator=(const ForwardList& rhs) {
     return *this;
 }
 
+// Move assignment, takes the nodes and the node cache of rhs
+template <typename T>
+ForwardList<T>& ForwardList<T>::operator=(ForwardList&& rhs) noexcept {
+    if(this == &rhs)
+        return *this;
+
+    clear();
+    shrink_cache();
+
+    head = rhs.head;
+    _size = rhs._size;
+    cache = rhs.cache;
+
+    rhs.head = NULL;
+    rhs._size = 0;
+    rhs.cache = NULL;
+
+    return *this;
+}
+
 // Deletes all nodes in list
 template <typename T>
 void ForwardList<T>::clear() noexcept {
@@ -181,12 +250,70 @@ void ForwardList<T>::clear() noexcept {
     _size = 0;
 }
 
+/**
+ * Destroys all elements but keeps up to n of their nodes, counting
+ * nodes already cached, for reuse by later insertions
+ */
+template <typename T>
+void ForwardList<T>::clear_keep_nodes(size_t n) noexcept {
+    size_t kept = 0;
+    for(Spare *s = cache; s != NULL && kept < n; s = s->next)
+        kept++;
+
+    Node<T> *ptr = head;
+    while(ptr != NULL) {
+        Node<T> *next = ptr->next;
+        if(kept < n) {
+            ptr->~Node();
+            cache = new (static_cast<void*>(ptr)) Spare{cache};
+            kept++;
+        }
+        else
+            delete ptr;
+        ptr = next;
+    }
+    head = NULL;
+    _size = 0;
+}
+
+// Frees every cached node
+template <typename T>
+void ForwardList<T>::shrink_cache() noexcept {
+    while(cache != NULL) {
+        Spare *next = cache->next;
+        if constexpr (alignof(Node<T>) > __STDCPP_DEFAULT_NEW_ALIGNMENT__)
+            ::operator delete(static_cast<void*>(cache), std::align_val_t(alignof(Node<T>)));
+        else
+            ::operator delete(static_cast<void*>(cache));
+        cache = next;
+    }
+}
+
+// Builds a node, reusing cached storage when there is any
+template <typename T>
+template <typename... Args>
+Node<T>* ForwardList<T>::create_node(Node<T> *next, Args&&... args) {
+    if(cache == NULL)
+        return new Node<T>(std::in_place, next, std::forward<Args>(args)...);
+
+    Spare *s = cache;
+    cache = s->next;
+    try {
+        return new (static_cast<void*>(s)) Node<T>(std::in_place, next, std::forward<Args>(args)...);
+    }
+    catch(...) {
+        cache = new (static_cast<void*>(s)) Spare{cache};
+        throw;
+    }
+}
+
 // Inserts new node after node pointed to by itr
 template <typename T>
 typename ForwardList<T>::iterator 
 ForwardList<T>::insert_after(const_iterator itr, const T& info) {
-    auto newNode = new Node<T>(info, itr.current->next);
-    itr.current->next = newNode;
+    auto pos = const_cast<Node<T>*>(itr.current);
+    auto newNode = create_node(pos->next, info);
+    pos->next = newNode;
 
     _size++;
 
@@ -197,8 +324,23 @@ ForwardList<T>::insert_after(const_iterator itr, const T& info) {
 template <typename T>
 typename ForwardList<T>::iterator
 ForwardList<T>::insert_after(const_iterator itr, T&& info) {
-    auto newNode = new Node<T>(std::move(info), itr.current->next);
-    itr.current->next = newNode;
+    auto pos = const_cast<Node<T>*>(itr.current);
+    auto newNode = create_node(pos->next, std::move(info));
+    pos->next = newNode;
+
+    _size++;
+
+    return iterator(newNode);
+}
+
+// Constructs new node in place after node pointed to by itr
+template <typename T>
+template <typename... Args>
+typename ForwardList<T>::iterator
+ForwardList<T>::emplace_after(const_iterator itr, Args&&... args) {
+    auto pos = const_cast<Node<T>*>(itr.current);
+    auto newNode = create_node(pos->next, std::forward<Args>(args)...);
+    pos->next = newNode;
 
     _size++;
 
@@ -209,9 +351,10 @@ ForwardList<T>::insert_after(const_iterator itr, T&& info) {
 template <typename T>
 typename ForwardList<T>::iterator
 ForwardList<T>::erase_after(const_iterator itr) {
-    auto temp = itr.current->next->next;
-    delete itr.current->next;
-    itr.current->next = temp;
+    auto pos = const_cast<Node<T>*>(itr.current);
+    auto temp = pos->next->next;
+    delete pos->next;
+    pos->next = temp;
 
     _size--;
 
@@ -221,7 +364,7 @@ ForwardList<T>::erase_after(const_iterator itr) {
 // Inserts new node at front of list
 template <typename T>
 void ForwardList<T>::push_front(const T& info) {
-    auto newNode = new Node<T>(info, head);
+    auto newNode = create_node(head, info);
     head = newNode;
     _size++;
 }
@@ -229,11 +372,21 @@ void ForwardList<T>::push_front(const T& info) {
 // Inserts new node at front of list
 template <typename T>
 void ForwardList<T>::push_front(T&& info) {
-    auto newNode = new Node<T>(std::move(info), head);
+    auto newNode = create_node(head, std::move(info));
     head = newNode;
     _size++;
 }
 
+// Constructs new node in place at front of list
+template <typename T>
+template <typename... Args>
+T& ForwardList<T>::emplace_front(Args&&... args) {
+    head = create_node(head, std::forward<Args>(args)...);
+    _size++;
+
+    return head->data;
+}
+
 // Removes node at front of list
 template <typename T>
 void ForwardList<T>::pop_front() {
@@ -244,6 +397,18 @@ void ForwardList<T>::pop_front() {
     _size--;
 }
 
+// Moves the first node of other to the front of this list, no allocation
+template <typename T>
+void ForwardList<T>::splice_front(ForwardList& other) noexcept {
+    Node<T> *moved = other.head;
+    other.head = moved->next;
+    other._size--;
+
+    moved->next = head;
+    head = moved;
+    _size++;
+}
+
 // Removes all nodes with data matching val
 template <typename T>
 void ForwardList<T>::remove(const T& val) {
@@ -257,6 +422,27 @@ void ForwardList<T>::remove(const T& val) {
     }
 }
 
+// Removes all nodes whose data satisfies pred in one pass, returns how many
+template <typename T>
+template <typename Pred>
+size_t ForwardList<T>::remove_if(Pred pred) {
+    size_t before = _size;
+    while(head != NULL && pred(head->data))
+        pop_front();
+    if(empty())
+        return before;
+
+    auto itr = cbegin();
+    while(itr.current->next != NULL) {
+        if(pred(itr.current->next->data))
+            erase_after(itr);
+        else
+            ++itr;
+    }
+
+    return before - _size;
+}
+
 
 template <typename F>
 ostream& operator<<(ostream &os, const ForwardList<F> &rhs) {
@@ -10,52 +10,222 @@
 #ifndef _HASHMAP_H
 #define _HASHMAP_H
 
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <cstdint>
 #include <string>
 #include <stdexcept>
 #include <functional>
+#include <iterator>
+#include <new>
+#include <tuple>
+#include <type_traits>
 #include <utility>
 
 #include "ForwardList.h"
+#include "Hasher.h"
+#include "Pair.h"
+#include "RehashPolicy.h"
 #include "Vector.h"
 
 
 /**
- * @brief Pair structure to group two objects (often key and value)
+ * @brief Whether UnorderedMap stores each key's full hash in its node
  *
- * @tparam T1 first object type
- * @tparam T2 second object type
+ * On by default for keys that are not scalars, where hashing and comparing
+ * are expensive (strings and other user types). Specialize to opt a key or
+ * hasher in or out.
  */
-template <typename T1, typename T2>
-struct Pair
+template <typename Key, typename Hash>
+struct cache_hash_code : std::bool_constant<!std::is_scalar_v<Key>> {};
+
+/**
+ * @brief Whether nodes without a cached hash keep an 8-bit fingerprint of it
+ *
+ * Bucket walks compare fingerprints before keys, so a costly key compare
+ * only runs for about one in 256 non-matching nodes. On by default for
+ * keys that are not scalars. Has no effect when cache_hash_code is set,
+ * since the full hash is compared instead.
+ */
+template <typename Key, typename Hash>
+struct hash_fingerprint : std::bool_constant<!std::is_scalar_v<Key>> {};
+
+/**
+ * @brief Whether F declares is_transparent, allowing lookup by other types
+ */
+template <typename F, typename = void>
+struct is_transparent : std::false_type {};
+
+template <typename F>
+struct is_transparent<F, std::void_t<typename F::is_transparent>> : std::true_type {};
+
+/**
+ * @brief Whether It is at least a forward iterator, so a range can be
+ * measured with std::distance before it is read
+ */
+template <typename It, typename = void>
+struct is_forward_iterator : std::false_type {};
+
+template <typename It>
+struct is_forward_iterator<It, std::void_t<typename std::iterator_traits<It>::iterator_category>>
+    : std::is_base_of<std::forward_iterator_tag,
+                      typename std::iterator_traits<It>::iterator_category> {};
+
+/**
+ * @brief Tag for the range constructor and insert, promising that no key
+ * in the range is repeated or already in the map
+ */
+struct assume_unique_t { explicit assume_unique_t() = default; };
+inline constexpr assume_unique_t assume_unique{};
+
+/**
+ * @brief Pair stored in an UnorderedMap bucket, with its full hash if
+ * Cache is set, else its hash fingerprint if Tag is set
+ */
+template <typename P, bool Cache, bool Tag>
+struct HashEntry : P
 {
-    T1 first;
-    T2 second;
+    size_t hash;
 
-    Pair(const T1& f = T1(), const T2& s = T2()) : first(f), second(s) {}
-    template <typename U1, typename U2> Pair(U1&& f, U2&& s)
-        : first(std::forward<U1>(f)), second(std::forward<U2>(s)) {}
-    Pair(const Pair& other) = default;
-    Pair(Pair&& p) = default;
+    template <typename... Args>
+    HashEntry(size_t hs, Args&&... args) : P(std::forward<Args>(args)...), hash(hs) {}
+};
 
-    Pair& operator=(const Pair&) = default;
-    Pair& operator=(Pair&&) = default;
+template <typename P>
+struct HashEntry<P, false, true> : P
+{
+    uint8_t tag;
 
-    bool operator==(const Pair& rhs) const noexcept
-        { return first == rhs.first; }
-    bool operator!=(const Pair& rhs) const noexcept
-        { return !(first == rhs.first); }
+    template <typename... Args>
+    HashEntry(size_t hs, Args&&... args) : P(std::forward<Args>(args)...), tag(fingerprint(hs)) {}
 
-    template <typename F, typename G>
-    friend ostream& operator<<(ostream&, const Pair<F,G>&);
+    // Top byte of the hash times an odd constant, independent of the bucket
+    // index under both rehash policies
+    static uint8_t fingerprint(size_t hs) noexcept
+        { return (uint8_t)(((uint64_t)hs * 0xBF58476D1CE4E5B9ULL) >> 56); }
 };
 
-template<typename F, typename G>
-ostream& operator<<(ostream & os, const Pair<F,G> &p) {
-    os << "(" << p.first << ", " << p.second << ") ";
+template <typename P>
+struct HashEntry<P, false, false> : P
+{
+    template <typename... Args>
+    HashEntry(size_t, Args&&... args) : P(std::forward<Args>(args)...) {}
+};
 
-    return os;
+/**
+ * @brief Hints that p will be read soon, a no-op without a compiler builtin
+ */
+inline void prefetch_read(const void *p) noexcept {
+#if defined(__GNUC__) || defined(__clang__)
+    __builtin_prefetch(p, 0, 3);
+#else
+    (void)p;
+#endif
 }
 
+/**
+ * @brief Fixed size array whose elements are built and destroyed a chunk
+ * at a time
+ *
+ * Storage is allocated uninitialized. build(k) value-initializes the next
+ * k elements, and teardown(k) destroys the last k built ones and frees the
+ * storage once none are left. Only the first built elements may be used.
+ * This lets an incremental rehash prepare and release a bucket array of
+ * any size without one step that scales with its size.
+ */
+template <typename C>
+class BucketArray
+{
+    C *_data;
+    size_t _size;
+    size_t _built;
+
+public:
+    typedef typename Vector<C>::iterator iterator;
+    typedef typename Vector<C>::const_iterator const_iterator;
+
+    BucketArray() noexcept : _data(nullptr), _size(0), _built(0) {}
+    explicit BucketArray(size_t n, bool construct = true)
+        : _data(n ? static_cast<C*>(::operator new(n * sizeof(C))) : nullptr),
+          _size(n), _built(0) {
+        if(construct)
+            build(n);
+    }
+    BucketArray(const BucketArray& other) : BucketArray(other._size, false) {
+        try {
+            for(; _built < other._built; _built++)
+                new (_data + _built) C(other._data[_built]);
+        }
+        catch(...) {
+            release();
+            throw;
+        }
+    }
+    BucketArray(BucketArray&& other) noexcept
+        : _data(other._data), _size(other._size), _built(other._built) {
+        other._data = nullptr;
+        other._size = other._built = 0;
+    }
+    ~BucketArray() { release(); }
+
+    BucketArray& operator=(const BucketArray& other) {
+        if(this != &other)
+            *this = BucketArray(other);
+        return *this;
+    }
+    BucketArray& operator=(BucketArray&& other) noexcept {
+        if(this != &other) {
+            release();
+            _data = other._data;
+            _size = other._size;
+            _built = other._built;
+            other._data = nullptr;
+            other._size = other._built = 0;
+        }
+        return *this;
+    }
+
+          C& operator[](size_t i) { return _data[i]; }
+    const C& operator[](size_t i) const { return _data[i]; }
+          C* data() noexcept { return _data; }
+    const C* data() const noexcept { return _data; }
+          iterator end() noexcept { return iterator(_data + _size); }
+    const_iterator cend() const noexcept { return const_iterator(_data + _size); }
+
+    size_t size() const noexcept { return _size; }
+    bool empty() const noexcept { return _size == 0; }
+    bool built() const noexcept { return _built == _size; }
+
+    // Builds up to k more elements, returns true once all are built
+    bool build(size_t k) {
+        size_t end = _built + std::min(k, _size - _built);
+        for(; _built < end; _built++)
+            new (_data + _built) C();
+        return built();
+    }
+
+    // Destroys up to k elements, returns true once the storage is freed
+    bool teardown(size_t k) noexcept {
+        size_t end = _built - std::min(k, _built);
+        while(_built > end)
+            _data[--_built].~C();
+        if(_built == 0)
+            release();
+        return empty();
+    }
+
+private:
+    void release() noexcept {
+        while(_built > 0)
+            _data[--_built].~C();
+        if(_data != nullptr)
+            ::operator delete(_data);
+        _data = nullptr;
+        _size = 0;
+    }
+};
+
 
 /* * * * * * * * * * * * * * * * * * * * * * * * *
  *
@@ -63,38 +233,161 @@ ostream& operator<<(ostream & os, const Pair<F,G> &p) {
  *
  * Uses hashing to store key, value pairs similar
  * std::unordered_map. Templated using key type,
- * value type, and a hash object. Stores pairs in
- * a vector of linked lists (chaining collision
- * resolution).
+ * value type, a hash object (Hasher by default),
+ * a key equality object, and a rehash policy
+ * that sizes the bucket array and maps hashes to
+ * buckets
+ * (PrimeRehashPolicy or PowerOfTwoRehashPolicy).
+ * Stores pairs in a vector of linked lists
+ * (chaining collision resolution). When
+ * cache_hash_code is set each node also keeps
+ * its key's hash, so rehashing never calls the
+ * hasher and bucket walks only compare keys
+ * whose hashes match. Otherwise hash_fingerprint
+ * keeps an 8-bit slice of it for the same use.
+ *
+ * With incremental_rehash(true), growing keeps
+ * the old bucket array and moves a few buckets
+ * per insert (or per rehash_step call) instead of
+ * all at once, like the Redis dict. A key is in
+ * the old array until its old bucket is moved, so
+ * lookups still probe one bucket. The bucket
+ * interface describes the new array only. The
+ * new array is allocated uninitialized and built
+ * BuildStep buckets per step before any move
+ * starts, and the old one is destroyed the same
+ * way after, so no insert does work that scales
+ * with the bucket count.
+ *
+ * Each bucket array has a bitmap with a bit set
+ * per non-empty bucket. begin() and ++ find the
+ * next element by scanning it a 64-bit word at
+ * a time, so iterating a sparse map costs time
+ * in its size rather than its bucket count.
+ *
+ * Setting min_load_factor above zero shrinks the
+ * bucket array when erase(key) or erase_if leave
+ * the load below it. Keep it well under half of
+ * max_load_factor so the map does not thrash.
+ *
+ * When Hash and KeyEqual are transparent, find,
+ * count, bucket,
+ * try_emplace and operator[] also take any key
+ * type the hasher and operator== accept (such as
+ * std::string_view for std::string keys), with no
+ * temporary Key built for the lookup.
+ *
+ * When the hasher is reseedable (as Hasher is),
+ * an insert into a bucket already holding
+ * ChainLimit times the max load factor nodes is
+ * taken as hash flooding: the hasher gets a
+ * fresh random seed and every key is rehashed,
+ * so crafted collisions no longer collide. It
+ * happens at most once per doubling in size.
+ * With incremental_rehash(true) the reseed is
+ * itself an incremental rehash into a new array
+ * of the same size: nodes are rehashed with the
+ * new seed as their buckets move, and keys not
+ * yet moved are found with the old one.
+ *
+ * Building from a range of forward iterators
+ * (the range constructor or insert(first, last))
+ * counts the range first and sizes the buckets
+ * once, so no rehash runs part way through.
+ * Passing assume_unique also skips the search
+ * for each key, which the caller must guarantee
+ * is not repeated; a repeated key is stored twice.
  *
  * * * * * * * * * * * * * * * * * * * * * * * * */
 
-template <typename Key, typename T, typename Hash = std::hash<Key>>
+template <typename Key, typename T, typename Hash = Hasher<Key>,
+          typename KeyEqual = std::equal_to<Key>,
+          typename RehashPolicy = PrimeRehashPolicy>
 class UnorderedMap
 {
     typedef Pair<const Key, T> pair;
+    static constexpr bool cache_hash = cache_hash_code<Key, Hash>::value;
+    static constexpr bool fingerprint = !cache_hash && hash_fingerprint<Key, Hash>::value;
+    typedef HashEntry<pair, cache_hash, fingerprint> entry;
+    typedef ForwardList<entry> chain;
     class map_iterator;
     class const_map_iterator;
 
-    Vector<ForwardList<pair>> A;
+    // Non-empty old buckets moved per insert during an incremental rehash
+    static constexpr size_t RehashStep = 4;
+    // Buckets built or destroyed per unit of rehash_step work
+    static constexpr size_t BuildStep = 256;
+    // Keys whose buckets and first nodes are prefetched together by find_many
+    static constexpr size_t PrefetchBatch = 16;
+    // Chain length, per unit of max load factor, that triggers a reseed
+    static constexpr size_t ChainLimit = 16;
+
+    // Lookup types other than Key, accepted when hasher and equality are transparent
+    template <typename K>
+    static constexpr bool transparent_key =
+        is_transparent<Hash>::value && is_transparent<KeyEqual>::value &&
+        !std::is_same_v<std::remove_cvref_t<K>, Key>;
+
+    BucketArray<chain> A;
+    BucketArray<uint64_t> occupied; // bit i set when A[i] is not empty
     Hash h;
+    KeyEqual eq;
+    RehashPolicy policy;
     size_t currentSize;
     float _max_load_factor;
+    float _min_load_factor;
+
+    // Old bucket array while an incremental rehash is in progress
+    BucketArray<chain> old;
+    BucketArray<uint64_t> oldOccupied;
+    RehashPolicy oldPolicy;
+    size_t migrated;
+    Hash oldHash;               // hasher of old while reseeding
+    bool reseeding;
+
+    // Next bucket array while it is being built, before any bucket moves
+    BucketArray<chain> staged;
+    BucketArray<uint64_t> stagedOccupied;
+    RehashPolicy stagedPolicy;
+    uint64_t stagedSeed;        // seed h takes when staged is swapped in
+    bool stagedReseed;
+    bool incremental;
+
+    // Size at the last reseed, another needs at least twice as many elements
+    size_t reseedSize;
 
 public:
-    typedef typename ForwardList<pair>::iterator local_iterator;
-    typedef typename ForwardList<pair>::const_iterator const_local_iterator;
+    typedef typename chain::iterator local_iterator;
+    typedef typename chain::const_iterator const_local_iterator;
 
     typedef map_iterator iterator;
     typedef const_map_iterator const_iterator;
 
 
     UnorderedMap() : UnorderedMap(1) {}
-    UnorderedMap(size_t n, const Hash& hs = Hash())
-        : A(Vector<ForwardList<pair>>(nextPrime(n))),
+    UnorderedMap(size_t n, const Hash& hs = Hash(), const KeyEqual& e = KeyEqual())
+        : A(RehashPolicy().next_bucket_count(n)),
+          occupied(make_bits(A.size())),
           h(hs),
+          eq(e),
           currentSize(0),
-          _max_load_factor(1.0) {}
+          _max_load_factor(1.0),
+          _min_load_factor(0.0),
+          migrated(0),
+          oldHash(hs),
+          reseeding(false),
+          stagedSeed(0),
+          stagedReseed(false),
+          incremental(false),
+          reseedSize(0) { policy.reset(A.size()); }
+    template <typename InputIt, typename = std::enable_if_t<!std::is_integral_v<InputIt>>>
+    UnorderedMap(InputIt first, InputIt last, size_t n = 1,
+                 const Hash& hs = Hash(), const KeyEqual& e = KeyEqual())
+        : UnorderedMap(n, hs, e) { insert_range(first, last, false); }
+    template <typename InputIt>
+    UnorderedMap(assume_unique_t, InputIt first, InputIt last, size_t n = 1,
+                 const Hash& hs = Hash(), const KeyEqual& e = KeyEqual())
+        : UnorderedMap(n, hs, e) { insert_range(first, last, true); }
     UnorderedMap(const UnorderedMap&) = default;
     UnorderedMap(UnorderedMap&&) = default;
     ~UnorderedMap() = default;
@@ -102,29 +395,58 @@ public:
     UnorderedMap& operator=(const UnorderedMap&);
     UnorderedMap& operator=(UnorderedMap&&);
 
-          iterator begin() noexcept { return make_iterator(0, A[0].begin()); }
-    const_iterator cbegin() const noexcept
-        { return make_const_iterator(0, A[0].cbegin()); }
-          iterator end() noexcept { return make_iterator(bucket_count()); }
-    const_iterator cend() const noexcept
-        { return make_const_iterator(bucket_count()); }
+          iterator begin() noexcept;
+    const_iterator cbegin() const noexcept;
+          iterator end() noexcept { return make_iterator(A.end()); }
+    const_iterator cend() const noexcept { return make_const_iterator(A.cend()); }
 
     bool empty() const noexcept { return currentSize == 0; }
     size_t size() const noexcept { return currentSize; }
 
-    void clear() noexcept { A.clear(); }
+    void clear() noexcept;
     Pair<iterator, bool> insert(const pair&);
     Pair<iterator, bool> insert(pair&&);
-    //iterator erase(iterator);
-    //iterator erase(const_iterator);
-    //size_t erase(const Key&);
+    template <typename InputIt, typename = std::enable_if_t<!std::is_integral_v<InputIt>>>
+    void insert(InputIt first, InputIt last) { insert_range(first, last, false); }
+    template <typename InputIt>
+    void insert(assume_unique_t, InputIt first, InputIt last) { insert_range(first, last, true); }
+    template <typename... Args> Pair<iterator, bool> emplace(Args&&...);
+    template <typename K, typename V> Pair<iterator, bool> emplace(K&&, V&&);
+    template <typename... Args> Pair<iterator, bool> try_emplace(const Key&, Args&&...);
+    template <typename... Args> Pair<iterator, bool> try_emplace(Key&&, Args&&...);
+    template <typename M> Pair<iterator, bool> insert_or_assign(const Key&, M&&);
+    template <typename M> Pair<iterator, bool> insert_or_assign(Key&&, M&&);
+    iterator erase(iterator pos) { return erase(const_iterator(pos)); }
+    iterator erase(const_iterator);
+    size_t erase(const Key&);
+    template <typename Pred> size_t erase_if(Pred);
 
     //T& at(const Key&);
     //const T& at(const Key&) const;
-    T& operator[](const Key&);
-    iterator find(const Key&);
-    const_iterator find(const Key&) const;
+    T& operator[](const Key& k) { return try_emplace(k).first->second; }
+    T& operator[](Key&& k) { return try_emplace(std::move(k)).first->second; }
+    iterator find(const Key& k) { return find_key(k); }
+    const_iterator find(const Key& k) const { return find_key(k); }
     size_t count(const Key& k) const { return (find(k) != cend()) ? 1 : 0; }
+    void find_many(const Key*, size_t, iterator*);
+    void find_many(const Key*, size_t, const_iterator*) const;
+    size_t count_many(const Key*, size_t, size_t* = nullptr) const;
+
+    template <typename K, typename... Args>
+    auto try_emplace(K&& k, Args&&... args)
+    -> std::enable_if_t<transparent_key<K>, Pair<iterator, bool>> {
+        return emplace_unique(k, std::piecewise_construct,
+                              std::forward_as_tuple(std::forward<K>(k)),
+                              std::forward_as_tuple(std::forward<Args>(args)...));
+    }
+    template <typename K, typename = std::enable_if_t<transparent_key<K>>>
+    T& operator[](K&& k) { return try_emplace(std::forward<K>(k)).first->second; }
+    template <typename K, typename = std::enable_if_t<transparent_key<K>>>
+    iterator find(const K& k) { return find_key(k); }
+    template <typename K, typename = std::enable_if_t<transparent_key<K>>>
+    const_iterator find(const K& k) const { return find_key(k); }
+    template <typename K, typename = std::enable_if_t<transparent_key<K>>>
+    size_t count(const K& k) const { return (find_key(k) != cend()) ? 1 : 0; }
 
     local_iterator begin(size_t n) { return A[n].begin(); }
     const_local_iterator cbegin(size_t n) const { return A[n].cbegin(); }
@@ -132,39 +454,117 @@ public:
     const_local_iterator cend(size_t n) const { return A[n].cend(); }
     size_t bucket_count() const { return A.size(); }
     size_t bucket_size(size_t n) const { return A[n].size(); }
-    size_t bucket(const Key& k) const { return h(k, bucket_count()); }
+    size_t bucket(const Key& k) const { return policy.index(h(k)); }
+    template <typename K, typename = std::enable_if_t<transparent_key<K>>>
+    size_t bucket(const K& k) const { return policy.index(h(k)); }
 
     float load_factor() const { return (float)currentSize / (float)bucket_count(); }
     float max_load_factor() const { return _max_load_factor; }
     void max_load_factor(float ml) { _max_load_factor = ml; }
+    float min_load_factor() const { return _min_load_factor; }
+    void min_load_factor(float ml) { _min_load_factor = ml; }
     void rehash(size_t);
     void reserve(size_t n) { rehash(std::ceil(n / max_load_factor())); }
 
+    bool incremental_rehash() const noexcept { return incremental; }
+    void incremental_rehash(bool on) noexcept { incremental = on; }
+    bool rehashing() const noexcept { return !old.empty() || !staged.empty(); }
+    bool rehash_step(size_t = RehashStep);
+
+    template <typename HH = Hash, typename = std::enable_if_t<is_reseedable<HH>::value>>
+    void reseed(uint64_t);
+
 private:
-    size_t nextPrime(size_t);
+    template <typename K> chain& chain_for(const K&, size_t&);
+    template <typename K> const chain& chain_for(const K&, size_t&) const;
+    template <typename K> iterator find_key(const K&);
+    template <typename K> const_iterator find_key(const K&) const;
+    template <typename Self, typename Fn>
+    static void probe_many(Self&, const Key*, size_t, Fn);
+    template <typename K> local_iterator find_in_chain(chain&, size_t, const K&);
+    template <typename K>
+    const_local_iterator find_in_chain(const chain&, size_t, const K&) const;
+    template <typename K, typename... Args>
+    Pair<iterator, bool> emplace_unique(const K&, Args&&...);
+    template <typename InputIt> void insert_range(InputIt, InputIt, bool);
+    size_t grow_size(size_t) const;
+    BucketArray<chain> make_buckets(size_t, RehashPolicy&, bool = true) const;
+    void resize_buckets(size_t);
+    void shrink_if_sparse();
+    void finish_rehash();
+    bool flooded(const chain&) const;
+    template <typename K> void check_flood(chain*&, const K&, size_t&);
+    void stage_reseed(uint64_t);
+    void track(const chain&) noexcept;
+    const chain* next_occupied(const chain*) const noexcept;
+
+    static BucketArray<uint64_t> make_bits(size_t n, bool construct = true)
+        { return BucketArray<uint64_t>((n + 63) / 64, construct); }
+    // Whether buckets are being moved from old, or old is being destroyed
+    bool migrating() const noexcept { return !old.empty(); }
+
+    // First set bit at or after i, n if there is none below n
+    static size_t next_set(const BucketArray<uint64_t>& bits, size_t i, size_t n) noexcept {
+        size_t w = i >> 6;
+        if(w >= bits.size())
+            return n;
+        uint64_t word = bits[w] & (~uint64_t(0) << (i & 63));
+        while(word == 0) {
+            if(++w == bits.size())
+                return n;
+            word = bits[w];
+        }
+
+        return std::min(n, (w << 6) + std::countr_zero(word));
+    }
+
+    // Hash of a stored entry, without calling the hasher when cached
+    size_t hash_of(const entry& e) const {
+        if constexpr (cache_hash)
+            return e.hash;
+        else
+            return h(e.first);
+    }
+
+    // Refreshes the cached hash or fingerprint of e to hash, after a reseed
+    void retag(entry& e, size_t hash) {
+        if constexpr (cache_hash)
+            e.hash = hash;
+        else if constexpr (fingerprint)
+            e.tag = entry::fingerprint(hash);
+    }
+
+    // Cached hashes or fingerprints are compared first to skip most key compares
+    template <typename K>
+    bool matches(const entry& e, size_t hash, const K& k) const {
+        if constexpr (cache_hash)
+            return e.hash == hash && eq(e.first, k);
+        else if constexpr (fingerprint)
+            return e.tag == entry::fingerprint(hash) && eq(e.first, k);
+        else
+            return eq(e.first, k);
+    }
 
     iterator make_iterator(
-        size_t ndx,
+        typename BucketArray<chain>::iterator b,
         local_iterator itr = local_iterator(NULL)
     ) {
-        return iterator(A.begin() + ndx, itr, *this);
+        return iterator(b, itr, *this);
     }
 
     const_iterator make_const_iterator(
-        size_t ndx,
+        typename BucketArray<chain>::const_iterator b,
         const_local_iterator itr = const_local_iterator(NULL)
     ) const {
-        return const_iterator(A.cbegin() + ndx, itr, *this);
+        return const_iterator(b, itr, *this);
     }
 
     class map_iterator
     {
-        typedef typename Vector<ForwardList<pair>>::iterator bucket_iterator;
+        typedef typename BucketArray<chain>::iterator bucket_iterator;
 
     public:
-        map_iterator() : bucket(nullptr), pos(nullptr) {}
-        map_iterator(const map_iterator &it)
-            : bucket(it.bucket), pos(it.pos), ref(it.ref) {}
+        map_iterator() : bucket(nullptr), pos(nullptr), ref(nullptr) {}
 
         pair& operator*() { return *pos; }
         pair* operator->() { return &(*pos); }
@@ -178,22 +578,25 @@ private:
     private:
         bucket_iterator bucket;
         local_iterator pos;
-        UnorderedMap &ref;
+        UnorderedMap *ref;
 
         map_iterator(const bucket_iterator &b, const local_iterator &p, UnorderedMap &map)
-            : bucket(b), pos(p), ref(map) {}
+            : bucket(b), pos(p), ref(&map) {}
+
+        void skip_empty();
 
-        friend iterator UnorderedMap::make_iterator(size_t, local_iterator);
+        friend class const_map_iterator;
+        friend class UnorderedMap;
     }; // class map_iterator
 
     class const_map_iterator
     {
-        typedef typename Vector<ForwardList<pair>>::const_iterator const_bucket_iterator;
+        typedef typename BucketArray<chain>::const_iterator const_bucket_iterator;
 
     public:
-        const_map_iterator() : bucket(nullptr), pos(nullptr) {}
+        const_map_iterator() : bucket(nullptr), pos(nullptr), ref(nullptr) {}
         const_map_iterator(const map_iterator &it)
-            : bucket(it.bucket), pos(it.pos), ref(it.ret) {}
+            : bucket(&*it.bucket), pos(it.pos), ref(it.ref) {}
 
         const pair& operator*() { return *pos; }
         const pair* operator->() { return &(*pos); }
@@ -207,17 +610,19 @@ private:
     private:
         const_bucket_iterator bucket;
         const_local_iterator pos;
-        const UnorderedMap &ref;
+        const UnorderedMap *ref;
 
         const_map_iterator(const_bucket_iterator b, const_local_iterator p, const UnorderedMap &map)
-            : bucket(b), pos(p), ref(map) {}
+            : bucket(b), pos(p), ref(&map) {}
+
+        void skip_empty();
 
-        friend const_iterator UnorderedMap::make_const_iterator(size_t, const_local_iterator) const;
+        friend class UnorderedMap;
     }; // class const_map_iterator
 
 public:
-    template <typename F, typename G, typename I>
-    friend ostream& operator<<(ostream&, const UnorderedMap<F,G,I>&);
+    template <typename F, typename G, typename I, typename J, typename R>
+    friend ostream& operator<<(ostream&, const UnorderedMap<F,G,I,J,R>&);
 }; // class unordered_map
 
 
@@ -227,8 +632,11 @@ public:
  * Hash table implementation
  * * * * * * * * * * * * * * * */
 
-template <typename F, typename G, typename I>
-ostream& operator<<(ostream &os, const UnorderedMap<F,G,I>& rhs) {
+template <typename F, typename G, typename I, typename J, typename R>
+ostream& operator<<(ostream &os, const UnorderedMap<F,G,I,J,R>& rhs) {
+    for(size_t i = rhs.migrated; i < rhs.old.size(); i++){
+        os << rhs.old[i] << endl;
+    }
     for(size_t i = 0; i < rhs.bucket_count(); i++){
         os << rhs.A[i] << endl;
     }
@@ -236,218 +644,764 @@ ostream& operator<<(ostream &os, const UnorderedMap<F,G,I>& rhs) {
 }
 
 // Copy assignment
-template <typename Key, typename T, typename Hash>
-UnorderedMap<Key,T,Hash>&
-UnorderedMap<Key,T,Hash>::operator=(const UnorderedMap& other) {
+template <typename Key, typename T, typename Hash, typename E, typename P>
+UnorderedMap<Key,T,Hash,E,P>&
+UnorderedMap<Key,T,Hash,E,P>::operator=(const UnorderedMap& other) {
     if(!empty())
         clear();
 
     h = other.h;
+    eq = other.eq;
+    policy = other.policy;
     A = other.A;
+    occupied = other.occupied;
     currentSize = other.currentSize;
     _max_load_factor = other._max_load_factor;
+    _min_load_factor = other._min_load_factor;
+    old = other.old;
+    oldOccupied = other.oldOccupied;
+    oldPolicy = other.oldPolicy;
+    migrated = other.migrated;
+    oldHash = other.oldHash;
+    reseeding = other.reseeding;
+    staged = other.staged;
+    stagedOccupied = other.stagedOccupied;
+    stagedPolicy = other.stagedPolicy;
+    stagedSeed = other.stagedSeed;
+    stagedReseed = other.stagedReseed;
+    incremental = other.incremental;
+    reseedSize = other.reseedSize;
 
     return *this;
 }
 
 // Move assignment
-template <typename Key, typename T, typename Hash>
-UnorderedMap<Key,T,Hash>&
-UnorderedMap<Key,T,Hash>::operator=(UnorderedMap&& other) {
+template <typename Key, typename T, typename Hash, typename E, typename P>
+UnorderedMap<Key,T,Hash,E,P>&
+UnorderedMap<Key,T,Hash,E,P>::operator=(UnorderedMap&& other) {
     if(!empty())
         clear();
 
     h = std::move(other.h);
+    eq = std::move(other.eq);
+    policy = other.policy;
     A = std::move(other.A);
+    occupied = std::move(other.occupied);
     currentSize = other.currentSize;
     _max_load_factor = other._max_load_factor;
+    _min_load_factor = other._min_load_factor;
+    old = std::move(other.old);
+    oldOccupied = std::move(other.oldOccupied);
+    oldPolicy = other.oldPolicy;
+    migrated = other.migrated;
+    oldHash = std::move(other.oldHash);
+    reseeding = other.reseeding;
+    staged = std::move(other.staged);
+    stagedOccupied = std::move(other.stagedOccupied);
+    stagedPolicy = other.stagedPolicy;
+    stagedSeed = other.stagedSeed;
+    stagedReseed = other.stagedReseed;
+    incremental = other.incremental;
+    reseedSize = other.reseedSize;
 
     return *this;
 }
 
+// First element, unmoved old buckets come before the new array
+template <typename Key, typename T, typename H, typename E, typename P>
+auto UnorderedMap<Key,T,H,E,P>::begin() noexcept -> iterator {
+    chain *b = const_cast<chain*>(next_occupied(migrating() ? &old[migrated] : A.data()));
+    if(b == A.data() + A.size())
+        return end();
+
+    return make_iterator(b, b->begin());
+}
+
+// First element, unmoved old buckets come before the new array
+template <typename Key, typename T, typename H, typename E, typename P>
+auto UnorderedMap<Key,T,H,E,P>::cbegin() const noexcept -> const_iterator {
+    const chain *b = next_occupied(migrating() ? &old[migrated] : A.data());
+    if(b == A.data() + A.size())
+        return cend();
+
+    return make_const_iterator(b, b->cbegin());
+}
+
+// Removes every element, keeps the bucket count
+template <typename Key, typename T, typename H, typename E, typename P>
+void UnorderedMap<Key,T,H,E,P>::clear() noexcept {
+    for(size_t i = 0; i < A.size(); i++)
+        A[i].clear();
+    for(size_t i = 0; i < occupied.size(); i++)
+        occupied[i] = 0;
+    old = BucketArray<chain>();
+    oldOccupied = BucketArray<uint64_t>();
+    staged = BucketArray<chain>();
+    stagedOccupied = BucketArray<uint64_t>();
+    migrated = 0;
+    reseeding = false;
+    stagedReseed = false;
+    currentSize = 0;
+    reseedSize = 0;
+}
+
 // Insert pair, return iterator to pair and bool if inserted
-template <typename Key, typename T, typename H>
-auto UnorderedMap<Key,T,H>::insert(const pair& p) -> Pair<iterator, bool> {
-    bool ret = false;
-    if(load_factor() >= max_load_factor())
-        rehash(currentSize * 2);
-
-    size_t index = h(p.first) % bucket_count(); //hash index
-    auto itr = A[index].begin();
-    if(count(p.first) > 0) {
-        while(itr->first != p.first) {
-            ret = false;
-            ++itr;
-        }
+template <typename Key, typename T, typename H, typename E, typename P>
+auto UnorderedMap<Key,T,H,E,P>::insert(const pair& p) -> Pair<iterator, bool> {
+    return emplace_unique(p.first, p);
+}
+
+// Move insert
+template <typename Key, typename T, typename H, typename E, typename P>
+auto UnorderedMap<Key,T,H,E,P>::insert(pair&& p) -> Pair<iterator, bool> {
+    return emplace_unique(p.first, std::move(p));
+}
+
+/**
+ * Inserts every pair in [first, last). A forward range is counted first
+ * and the buckets grown once to fit it all, so the loop never rehashes.
+ * When unique is set each pair is linked into its bucket without searching
+ * it; otherwise a key already present keeps its value, as with insert.
+ */
+template <typename Key, typename T, typename H, typename E, typename P>
+template <typename InputIt>
+void UnorderedMap<Key,T,H,E,P>::insert_range(InputIt first, InputIt last, bool unique) {
+    if constexpr (is_forward_iterator<InputIt>::value) {
+        size_t n = currentSize + (size_t)std::distance(first, last);
+        if(n > bucket_count() * max_load_factor())
+            reserve(n);
     }
-    else {
-        A[index].push_front(p);
+    if(!unique) {
+        for(; first != last; ++first)
+            try_emplace((*first).first, (*first).second);
+        return;
+    }
+
+    for(; first != last; ++first) {
+        if(rehashing())
+            rehash_step();
+        else if(load_factor() >= max_load_factor())
+            resize_buckets(currentSize * 2);
+
+        size_t hash = h((*first).first);
+        chain *c = &chain_for((*first).first, hash);
+        check_flood(c, (*first).first, hash);
+        c->emplace_front(hash, (*first).first, (*first).second);
+        track(*c);
         currentSize++;
-        ret = true;
     }
-    auto retItr = make_iterator(index, itr);
-    return Pair<iterator, bool>(retItr, ret);
 }
 
-// Move insert
-template <typename Key, typename T, typename H>
-auto UnorderedMap<Key,T,H>::insert(pair&& p) -> Pair<iterator, bool> {
-    bool ret = false;
-    if(load_factor() >= max_load_factor())
-        rehash(currentSize * 2);
-
-    size_t index = h(p.first) % bucket_count(); //hash index
-    auto itr = A[index].begin();
-    if(count(p.first) > 0) {
-        while(itr->first != p.first) {
-            ret = false;
-            ++itr;
-        }
-    }
+// Builds a pair from args, inserts it if its key is absent
+template <typename Key, typename T, typename H, typename E, typename P>
+template <typename... Args>
+auto UnorderedMap<Key,T,H,E,P>::emplace(Args&&... args) -> Pair<iterator, bool> {
+    pair p(std::forward<Args>(args)...);
+    return emplace_unique(p.first, std::move(p));
+}
+
+// Emplace from a key and a value, the pair is only built on a miss
+template <typename Key, typename T, typename H, typename E, typename P>
+template <typename K, typename V>
+auto UnorderedMap<Key,T,H,E,P>::emplace(K&& k, V&& v) -> Pair<iterator, bool> {
+    if constexpr (std::is_same_v<std::remove_cvref_t<K>, Key>)
+        return try_emplace(std::forward<K>(k), std::forward<V>(v));
     else {
-        A[index].push_front(std::move(p));
-        currentSize++;
-        ret = true;
+        pair p(std::forward<K>(k), std::forward<V>(v));
+        return emplace_unique(p.first, std::move(p));
     }
-    auto retItr = make_iterator(index, itr);
-    return Pair<iterator, bool>(retItr, ret);
 }
 
-// Subscript operator
-template <typename Key, typename T, typename H>
-T& UnorderedMap<Key,T,H>::operator[](const Key& k) {
-    if(load_factor() >= max_load_factor())
-        rehash(currentSize * 2);
-    size_t ndx = h(k) % bucket_count();
-    bool found = false;
-    if(A[ndx].empty()) {
-        A[ndx].push_front(pair(k, T()));
-        currentSize++;
-        return A[ndx].front().second;
+// If k is absent, insert k with a value built from args
+template <typename Key, typename T, typename H, typename E, typename P>
+template <typename... Args>
+auto UnorderedMap<Key,T,H,E,P>::try_emplace(const Key& k, Args&&... args)
+-> Pair<iterator, bool> {
+    return emplace_unique(k, std::piecewise_construct,
+                          std::forward_as_tuple(k),
+                          std::forward_as_tuple(std::forward<Args>(args)...));
+}
+
+// If k is absent, move k in with a value built from args
+template <typename Key, typename T, typename H, typename E, typename P>
+template <typename... Args>
+auto UnorderedMap<Key,T,H,E,P>::try_emplace(Key&& k, Args&&... args)
+-> Pair<iterator, bool> {
+    return emplace_unique(k, std::piecewise_construct,
+                          std::forward_as_tuple(std::move(k)),
+                          std::forward_as_tuple(std::forward<Args>(args)...));
+}
+
+// Insert k with obj, or assign obj to the existing value
+template <typename Key, typename T, typename H, typename E, typename P>
+template <typename M>
+auto UnorderedMap<Key,T,H,E,P>::insert_or_assign(const Key& k, M&& obj)
+-> Pair<iterator, bool> {
+    auto ret = try_emplace(k, std::forward<M>(obj));
+    if(!ret.second)
+        ret.first->second = std::forward<M>(obj);
+
+    return ret;
+}
+
+// Insert k with obj, or assign obj to the existing value
+template <typename Key, typename T, typename H, typename E, typename P>
+template <typename M>
+auto UnorderedMap<Key,T,H,E,P>::insert_or_assign(Key&& k, M&& obj)
+-> Pair<iterator, bool> {
+    auto ret = try_emplace(std::move(k), std::forward<M>(obj));
+    if(!ret.second)
+        ret.first->second = std::forward<M>(obj);
+
+    return ret;
+}
+
+// Removes the element at pos, returns an iterator to the one after it
+template <typename Key, typename T, typename H, typename E, typename P>
+auto UnorderedMap<Key,T,H,E,P>::erase(const_iterator pos) -> iterator {
+    chain& c = const_cast<chain&>(*pos.bucket);
+    auto prev = c.end();
+    auto itr = c.begin();
+    while(const_local_iterator(itr) != pos.pos) {
+        prev = itr;
+        ++itr;
     }
-    else {
-        auto itr = begin(ndx);
-        while(itr != end(ndx)){
-            if(itr->first == k){
-                found = true;
-                break;
-            }
-            ++itr;
+
+    iterator next = make_iterator(&c, itr);
+    ++next;
+    if(prev == c.end())
+        c.pop_front();
+    else
+        c.erase_after(prev);
+    track(c);
+    currentSize--;
+
+    return next;
+}
+
+// Removes key k if present, returns the number of elements removed
+template <typename Key, typename T, typename H, typename E, typename P>
+size_t UnorderedMap<Key,T,H,E,P>::erase(const Key& k) {
+    if(rehashing())
+        rehash_step();
+
+    size_t hash = h(k);
+    chain& c = chain_for(k, hash);
+    auto prev = c.end();
+    auto itr = c.begin();
+    while(itr != c.end() && !matches(*itr, hash, k)) {
+        prev = itr;
+        ++itr;
+    }
+    if(itr == c.end())
+        return 0;
+
+    if(prev == c.end())
+        c.pop_front();
+    else
+        c.erase_after(prev);
+    track(c);
+    currentSize--;
+    shrink_if_sparse();
+
+    return 1;
+}
+
+// Removes every element satisfying pred in one sweep, returns how many
+template <typename Key, typename T, typename H, typename E, typename P>
+template <typename Pred>
+size_t UnorderedMap<Key,T,H,E,P>::erase_if(Pred pred) {
+    auto test = [&pred](entry& e) { return pred(static_cast<pair&>(e)); };
+    size_t removed = 0;
+    for(size_t i = migrated; i < old.size(); i++) {
+        removed += old[i].remove_if(test);
+        track(old[i]);
+    }
+    for(size_t i = 0; i < A.size(); i++) {
+        removed += A[i].remove_if(test);
+        track(A[i]);
+    }
+    currentSize -= removed;
+    shrink_if_sparse();
+
+    return removed;
+}
+
+// Return iterator to key if found, else end()
+template <typename Key, typename T, typename H, typename E, typename P>
+template <typename K>
+auto UnorderedMap<Key,T,H,E,P>::find_key(const K& k) -> iterator {
+    size_t hash = h(k);
+    chain& c = chain_for(k, hash);
+    auto itr = find_in_chain(c, hash, k);
+    if(itr == c.end())
+        return end();
+
+    return make_iterator(&c, itr);
+}
+
+// Return const_iterator to key if found, else cend()
+template <typename Key, typename T, typename H, typename E, typename P>
+template <typename K>
+auto UnorderedMap<Key,T,H,E,P>::find_key(const K& k) const -> const_iterator {
+    size_t hash = h(k);
+    const chain& c = chain_for(k, hash);
+    auto itr = find_in_chain(c, hash, k);
+    if(itr == c.cend())
+        return cend();
+
+    return make_const_iterator(&c, itr);
+}
+
+// Iterator for each of the n keys in out, end() for those not found
+template <typename Key, typename T, typename H, typename E, typename P>
+void UnorderedMap<Key,T,H,E,P>::find_many(const Key *keys, size_t n, iterator *out) {
+    probe_many(*this, keys, n, [this, out](size_t i, chain& c, local_iterator itr) {
+        out[i] = (itr == c.end()) ? end() : make_iterator(&c, itr);
+    });
+}
+
+// const_iterator for each of the n keys in out, cend() for those not found
+template <typename Key, typename T, typename H, typename E, typename P>
+void UnorderedMap<Key,T,H,E,P>::find_many(const Key *keys, size_t n,
+                                          const_iterator *out) const {
+    probe_many(*this, keys, n, [this, out](size_t i, const chain& c,
+                                           const_local_iterator itr) {
+        out[i] = (itr == c.cend()) ? cend() : make_const_iterator(&c, itr);
+    });
+}
+
+// Number of the n keys present, with count(keys[i]) in out[i] if given
+template <typename Key, typename T, typename H, typename E, typename P>
+size_t UnorderedMap<Key,T,H,E,P>::count_many(const Key *keys, size_t n, size_t *out) const {
+    size_t total = 0;
+    probe_many(*this, keys, n, [&total, out](size_t i, const chain& c,
+                                             const_local_iterator itr) {
+        size_t found = (itr != c.cend()) ? 1 : 0;
+        total += found;
+        if(out != nullptr)
+            out[i] = found;
+    });
+
+    return total;
+}
+
+/**
+ * Looks keys up PrefetchBatch at a time, calling fn(i, bucket, position)
+ * for each. A batch is hashed and all its bucket heads prefetched, then the
+ * first node of each bucket, and only then are the buckets walked, so the
+ * cache misses of a batch overlap instead of each waiting on the last.
+ */
+template <typename Key, typename T, typename H, typename E, typename P>
+template <typename Self, typename Fn>
+void UnorderedMap<Key,T,H,E,P>::probe_many(Self& m, const Key *keys, size_t n, Fn fn) {
+    size_t hashes[PrefetchBatch];
+    decltype(&m.A[0]) chains[PrefetchBatch];
+    for(size_t base = 0; base < n; base += PrefetchBatch) {
+        size_t batch = std::min(PrefetchBatch, n - base);
+        for(size_t i = 0; i < batch; i++) {
+            hashes[i] = m.h(keys[base + i]);
+            chains[i] = &m.chain_for(keys[base + i], hashes[i]);
+            prefetch_read(chains[i]);
+        }
+        for(size_t i = 0; i < batch; i++)
+            if(!chains[i]->empty())
+                prefetch_read(&chains[i]->front());
+        for(size_t i = 0; i < batch; i++)
+            fn(base + i, *chains[i], m.find_in_chain(*chains[i], hashes[i], keys[base + i]));
+    }
+}
+
+/**
+ * Bucket holding k, whose hash under h is hash, in the old array until it
+ * is moved. While a reseed is migrating, old is laid out by oldHash, so a
+ * key found there has hash replaced by its old hash, the one its nodes
+ * are tagged with.
+ */
+template <typename Key, typename T, typename H, typename E, typename P>
+template <typename K>
+auto UnorderedMap<Key,T,H,E,P>::chain_for(const K& k, size_t& hash) -> chain& {
+    if(migrating()) {
+        size_t oh = reseeding ? oldHash(k) : hash;
+        size_t ndx = oldPolicy.index(oh);
+        if(ndx >= migrated) {
+            hash = oh;
+            return old[ndx];
         }
-        if(!found){
-            A[ndx].push_front(pair(k, T()));
-            currentSize++;
-            return A[ndx].front().second;
+    }
+
+    return A[policy.index(hash)];
+}
+
+// Bucket holding k, as above
+template <typename Key, typename T, typename H, typename E, typename P>
+template <typename K>
+auto UnorderedMap<Key,T,H,E,P>::chain_for(const K& k, size_t& hash) const -> const chain& {
+    if(migrating()) {
+        size_t oh = reseeding ? oldHash(k) : hash;
+        size_t ndx = oldPolicy.index(oh);
+        if(ndx >= migrated) {
+            hash = oh;
+            return old[ndx];
         }
-        else return itr->second;
     }
+
+    return A[policy.index(hash)];
 }
 
-// Return iterator to key if found, else end()
-template <typename Key, typename T, typename H>
-auto UnorderedMap<Key,T,H>::find(const Key& k) -> iterator {
-    size_t index = h(k, bucket_count());
-    auto itr = begin(index);
-    do{
-        if(itr->first == k)
-            break;
+// Key k with the given hash in chain c, or c.end()
+template <typename Key, typename T, typename H, typename E, typename P>
+template <typename K>
+auto UnorderedMap<Key,T,H,E,P>::find_in_chain(chain& c, size_t hash, const K& k)
+-> local_iterator {
+    auto itr = c.begin();
+    while(itr != c.end() && !matches(*itr, hash, k))
         ++itr;
-    } while(itr != end(index));
 
-    return make_iterator(index, itr);
+    return itr;
 }
 
-// Return const_iterator to key if found, else cend()
-template <typename Key, typename T, typename H>
-auto UnorderedMap<Key,T,H>::find(const Key& k) const -> const_iterator {
-    size_t index = h(k) % bucket_count();
-    auto itr = cbegin(index);
-    while(itr != cend(index)) {
-        if(itr->first == k)
-            return make_const_iterator(index, itr);
+// Key k with the given hash in chain c, or c.cend()
+template <typename Key, typename T, typename H, typename E, typename P>
+template <typename K>
+auto UnorderedMap<Key,T,H,E,P>::find_in_chain(const chain& c, size_t hash, const K& k) const
+-> const_local_iterator {
+    auto itr = c.cbegin();
+    while(itr != c.cend() && !matches(*itr, hash, k))
         ++itr;
+
+    return itr;
+}
+
+/**
+ * Hashes key once and walks its bucket once. On a miss the pair is built
+ * in place from args, so nothing is constructed for a key already present.
+ * Moves a few buckets first when an incremental rehash is in progress, and
+ * does not start another one until it finishes.
+ */
+template <typename Key, typename T, typename H, typename E, typename P>
+template <typename K, typename... Args>
+auto UnorderedMap<Key,T,H,E,P>::emplace_unique(const K& key, Args&&... args)
+-> Pair<iterator, bool> {
+    if(rehashing())
+        rehash_step();
+
+    size_t hash = h(key);
+    chain *c = &chain_for(key, hash);
+    auto itr = find_in_chain(*c, hash, key);
+    if(itr != c->end())
+        return Pair<iterator, bool>(make_iterator(c, itr), false);
+
+    check_flood(c, key, hash);
+    if(!rehashing() && load_factor() >= max_load_factor()) {
+        resize_buckets(currentSize * 2);
+        c = &chain_for(key, hash);
     }
+    c->emplace_front(hash, std::forward<Args>(args)...);
+    track(*c);
+    currentSize++;
 
-    return cend();
+    return Pair<iterator, bool>(make_iterator(c, c->begin()), true);
 }
 
-// Rehash to new size n, n > currentSize / max_load_factor()
-template <typename Key, typename T, typename H>
-void UnorderedMap<Key,T,H>::rehash(size_t n) {
+// n raised so that the current size fits under the max load factor
+template <typename Key, typename T, typename H, typename E, typename P>
+size_t UnorderedMap<Key,T,H,E,P>::grow_size(size_t n) const {
     while(n < currentSize / max_load_factor())
         n = (size_t)(currentSize / max_load_factor() * 2);
-    Vector<ForwardList<pair>> temp(nextPrime(n));
+
+    return n;
+}
+
+// Empty bucket array of at least n buckets, resets p to match it. Left
+// unbuilt unless construct is set
+template <typename Key, typename T, typename H, typename E, typename P>
+auto UnorderedMap<Key,T,H,E,P>::make_buckets(size_t n, P& p, bool construct) const
+-> BucketArray<chain> {
+    BucketArray<chain> buckets(p.next_bucket_count(n), construct);
+    p.reset(buckets.size());
+
+    return buckets;
+}
+
+// Grows or shrinks to about n buckets, incrementally if enabled
+template <typename Key, typename T, typename H, typename E, typename P>
+void UnorderedMap<Key,T,H,E,P>::resize_buckets(size_t n) {
+    n = grow_size(n);
+    if(!incremental) {
+        rehash(n);
+        return;
+    }
+
+    staged = make_buckets(n, stagedPolicy, false);
+    stagedOccupied = make_bits(staged.size(), false);
+}
+
+// Shrinks once the load drops below min_load_factor, leaving it near
+// half of max_load_factor
+template <typename Key, typename T, typename H, typename E, typename P>
+void UnorderedMap<Key,T,H,E,P>::shrink_if_sparse() {
+    if(rehashing() || load_factor() >= min_load_factor())
+        return;
+
+    size_t n = (size_t)std::ceil(currentSize * 2 / max_load_factor());
+    if(policy.next_bucket_count(n) < bucket_count())
+        resize_buckets(n);
+}
+
+/**
+ * Does one slice of an incremental rehash, bounded by n. While the new
+ * array is staged, builds n * BuildStep of its buckets, and swaps it in
+ * once all are built. Then moves up to n non-empty old buckets into it,
+ * visiting at most 10 * n empty ones. Once all are moved, destroys
+ * n * BuildStep old buckets. Returns true while the rehash is not done.
+ * n is clamped to what finishes a phase, so rehash_step(SIZE_MAX) runs
+ * the current phase to the end.
+ */
+template <typename Key, typename T, typename H, typename E, typename P>
+bool UnorderedMap<Key,T,H,E,P>::rehash_step(size_t n) {
+    n = std::min(n, old.size() + staged.size() + 1);
+    if(!staged.empty()) {
+        staged.build(n * BuildStep);
+        stagedOccupied.build(n * BuildStep / 64 + 1);
+        if(staged.built() && stagedOccupied.built()) {
+            old = std::move(A);
+            oldOccupied = std::move(occupied);
+            oldPolicy = policy;
+            migrated = 0;
+            A = std::move(staged);
+            occupied = std::move(stagedOccupied);
+            policy = stagedPolicy;
+            if constexpr (is_reseedable<H>::value) {
+                if(stagedReseed) {
+                    oldHash = h;
+                    h.reseed(stagedSeed);
+                    reseeding = true;
+                    stagedReseed = false;
+                }
+            }
+        }
+        return true;
+    }
+    if(migrated == old.size()) {
+        if(migrating() && old.teardown(n * BuildStep)) {
+            oldOccupied = BucketArray<uint64_t>();
+            migrated = 0;
+            reseeding = false;
+        }
+        return rehashing();
+    }
+
+    size_t emptyVisits = n * 10;
+    while(n > 0 && migrated < old.size()) {
+        chain& c = old[migrated++];
+        if(c.empty()) {
+            if(--emptyVisits == 0)
+                break;
+            continue;
+        }
+        while(!c.empty()) {
+            size_t hash = hash_of(c.front());
+            if(reseeding) {
+                hash = h(c.front().first);
+                retag(c.front(), hash);
+            }
+            chain& dest = A[policy.index(hash)];
+            dest.splice_front(c);
+            track(dest);
+        }
+        track(c);
+        n--;
+    }
+
+    return true;
+}
+
+// Whether inserting into c should reseed the hasher
+template <typename Key, typename T, typename H, typename E, typename P>
+bool UnorderedMap<Key,T,H,E,P>::flooded(const chain& c) const {
+    float limit = ChainLimit * std::max(max_load_factor(), 1.0f);
+    return c.size() >= limit && currentSize >= reseedSize * 2;
+}
+
+/**
+ * Reseeds the hasher if c, the bucket about to receive key, is flooded.
+ * Done at once, updating c and hash to match, unless incremental rehash
+ * is on: then a reseed is staged like any other rehash, and put off while
+ * one is already in progress. Either way c stays valid for key.
+ */
+template <typename Key, typename T, typename H, typename E, typename P>
+template <typename K>
+void UnorderedMap<Key,T,H,E,P>::check_flood(chain*& c, const K& key, size_t& hash) {
+    if constexpr (is_reseedable<H>::value) {
+        if(!flooded(*c))
+            return;
+        if(!incremental) {
+            reseed(hash_random_seed());
+            hash = h(key);
+            c = &chain_for(key, hash);
+        }
+        else if(!rehashing())
+            stage_reseed(hash_random_seed());
+        else
+            return;
+        reseedSize = currentSize;
+    }
+}
+
+// Starts an incremental rehash into a new array of the same size, which
+// h hashes into with seed once all of its buckets are built
+template <typename Key, typename T, typename H, typename E, typename P>
+void UnorderedMap<Key,T,H,E,P>::stage_reseed(uint64_t seed) {
+    staged = make_buckets(A.size(), stagedPolicy, false);
+    stagedOccupied = make_bits(staged.size(), false);
+    stagedSeed = seed;
+    stagedReseed = true;
+}
+
+/**
+ * Gives the hasher a new seed and moves every node to its new bucket,
+ * refreshing cached hashes and fingerprints. The bucket count is kept.
+ */
+template <typename Key, typename T, typename H, typename E, typename P>
+template <typename HH, typename>
+void UnorderedMap<Key,T,H,E,P>::reseed(uint64_t seed) {
+    finish_rehash();
+    h.reseed(seed);
+    BucketArray<chain> temp(A.size());
+    BucketArray<uint64_t> bits = make_bits(A.size());
     for(size_t i = 0; i < A.size(); i++){
-        auto itr = A[i].begin();
-        while(itr != A[i].end()){
-            size_t index = h(itr->first) % temp.size();
-            temp[index].push_front(std::move(*itr));
-            ++itr;
+        while(!A[i].empty()){
+            entry& e = A[i].front();
+            size_t hash = h(e.first);
+            retag(e, hash);
+            size_t index = policy.index(hash);
+            temp[index].splice_front(A[i]);
+            bits[index >> 6] |= uint64_t(1) << (index & 63);
         }
     }
     A = std::move(temp);
+    occupied = std::move(bits);
 }
 
-// Return next prime number after num
-template <typename Key, typename T, typename H>
-size_t UnorderedMap<Key,T,H>::nextPrime(size_t num) {
-    bool isPrime = false;
-    while(!isPrime){
-        isPrime = true;
-        for(unsigned i = 2; i <=(num/2); ++i) {
-            if(num%i==0) {
-                num++;
-                isPrime = false;
-                break;
-            }
+// Updates the occupancy bit of bucket c, in either array, after it changed
+template <typename Key, typename T, typename H, typename E, typename P>
+void UnorderedMap<Key,T,H,E,P>::track(const chain& c) noexcept {
+    std::less<const chain*> before;
+    bool inA = !before(&c, A.data()) && before(&c, A.data() + A.size());
+    BucketArray<uint64_t>& bits = inA ? occupied : oldOccupied;
+    size_t i = &c - (inA ? A.data() : old.data());
+    uint64_t bit = uint64_t(1) << (i & 63);
+    if(c.empty())
+        bits[i >> 6] &= ~bit;
+    else
+        bits[i >> 6] |= bit;
+}
+
+/**
+ * First non-empty bucket at or after b, where b points into (or one past)
+ * either array. Unmoved old buckets come before the new array, and
+ * A.data() + A.size() means there is none.
+ */
+template <typename Key, typename T, typename H, typename E, typename P>
+auto UnorderedMap<Key,T,H,E,P>::next_occupied(const chain *b) const noexcept
+-> const chain* {
+    std::less<const chain*> before;
+    const chain *oldEnd = old.data() + old.size();
+    if(migrating() && !before(b, old.data()) && !before(oldEnd, b)) {
+        size_t i = next_set(oldOccupied, b - old.data(), old.size());
+        if(i < old.size())
+            return old.data() + i;
+        b = A.data();
+    }
+
+    return A.data() + next_set(occupied, b - A.data(), A.size());
+}
+
+// Completes an incremental rehash in progress
+template <typename Key, typename T, typename H, typename E, typename P>
+void UnorderedMap<Key,T,H,E,P>::finish_rehash() {
+    while(rehashing())
+        rehash_step(std::max(old.size(), staged.size()) + 1);
+}
+
+/**
+ * Rehash to new size n, n > currentSize / max_load_factor()
+ * Nodes are relinked into the new buckets, so the bucket array is the
+ * only allocation. Always done at once, finishing any incremental rehash.
+ */
+template <typename Key, typename T, typename H, typename E, typename P>
+void UnorderedMap<Key,T,H,E,P>::rehash(size_t n) {
+    finish_rehash();
+    P next;
+    BucketArray<chain> temp = make_buckets(grow_size(n), next);
+    BucketArray<uint64_t> bits = make_bits(temp.size());
+    for(size_t i = 0; i < A.size(); i++){
+        while(!A[i].empty()){
+            size_t index = next.index(hash_of(A[i].front()));
+            temp[index].splice_front(A[i]);
+            bits[index >> 6] |= uint64_t(1) << (index & 63);
         }
     }
-    return num;
+    A = std::move(temp);
+    occupied = std::move(bits);
+    policy = next;
 }
 
+// Moves to the next element when pos is past the end of its bucket
+template <typename Key, typename T, typename H, typename E, typename P>
+void UnorderedMap<Key,T,H,E,P>::map_iterator::skip_empty() {
+    if(pos != local_iterator(NULL))
+        return;
 
-template <typename Key, typename T, typename H>
+    chain *next = const_cast<chain*>(ref->next_occupied(&*bucket + 1));
+    bucket = next;
+    if(bucket != ref->A.end())
+        pos = next->begin();
+}
+
+template <typename Key, typename T, typename H, typename E, typename P>
 inline auto
-UnorderedMap<Key,T,H>::map_iterator::operator++() -> map_iterator& {
+UnorderedMap<Key,T,H,E,P>::map_iterator::operator++() -> map_iterator& {
     ++pos;
-
-    while(pos == bucket->end() && bucket != ref.A.end()) {
-        bucket++;
-        pos = bucket->begin();
-    }
-    if(bucket == ref.A.end())
-        pos = local_iterator(NULL);
+    skip_empty();
 
     return *this;
 }
 
-template <typename Key, typename T, typename H>
+template <typename Key, typename T, typename H, typename E, typename P>
 inline auto
-UnorderedMap<Key,T,H>::map_iterator::operator++(int) -> map_iterator {
+UnorderedMap<Key,T,H,E,P>::map_iterator::operator++(int) -> map_iterator {
     auto temp = *this;
     ++(*this);
     return temp;
 }
 
-template <typename Key, typename T, typename H>
+// Moves to the next element when pos is past the end of its bucket
+template <typename Key, typename T, typename H, typename E, typename P>
+void UnorderedMap<Key,T,H,E,P>::const_map_iterator::skip_empty() {
+    if(pos != const_local_iterator(NULL))
+        return;
+
+    const chain *next = ref->next_occupied(&*bucket + 1);
+    bucket = next;
+    if(bucket != ref->A.cend())
+        pos = next->cbegin();
+}
+
+template <typename Key, typename T, typename H, typename E, typename P>
 inline auto
-UnorderedMap<Key,T,H>::const_map_iterator::operator++()
+UnorderedMap<Key,T,H,E,P>::const_map_iterator::operator++()
 -> const_map_iterator& {
     ++pos;
-
-    while(pos == bucket->cend() && bucket != ref.A.cend()) {
-        bucket++;
-        pos = bucket->cbegin();
-    }
-    if(bucket == ref.A.cend())
-        pos = const_local_iterator(NULL);
+    skip_empty();
 
     return *this;
 }
 
-template <typename Key, typename T, typename H>
+template <typename Key, typename T, typename H, typename E, typename P>
 inline auto
-UnorderedMap<Key,T,H>::const_map_iterator::operator++(int)
+UnorderedMap<Key,T,H,E,P>::const_map_iterator::operator++(int)
 -> const_map_iterator {
     auto temp = *this;
     ++(*this);
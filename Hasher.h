@@ -0,0 +1,310 @@
+/**
+ * @file Hasher.h
+ * @author Jackson Brenneman
+ * @brief Default hash functions for the map containers
+ * @date 2023-11-26
+ *
+ */
+
+#ifndef _HASHER_H_
+#define _HASHER_H_
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <random>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+#include "Pair.h"
+
+
+/**
+ * @brief Constants for the wyhash mixing steps, from its reference code
+ */
+inline constexpr uint64_t HashSecret[] = {
+    0x2d358dccaa6c78a5ULL, 0x8bb84b93962eacc9ULL,
+    0x4b33a62ed433d4a3ULL, 0x4d5a2da51de1aa47ULL
+};
+
+// Full 128-bit product of a and b, low half in a and high half in b
+inline void hash_mum(uint64_t& a, uint64_t& b) noexcept {
+#if defined(__SIZEOF_INT128__)
+    unsigned __int128 r = (unsigned __int128)a * b;
+    a = (uint64_t)r;
+    b = (uint64_t)(r >> 64);
+#else
+    uint64_t ha = a >> 32, hb = b >> 32, la = (uint32_t)a, lb = (uint32_t)b;
+    uint64_t rh = ha * hb, rm0 = ha * lb, rm1 = hb * la, rl = la * lb;
+    uint64_t t = rl + (rm0 << 32);
+    uint64_t c = t < rl;
+    uint64_t lo = t + (rm1 << 32);
+    c += lo < t;
+    a = lo;
+    b = rh + (rm0 >> 32) + (rm1 >> 32) + c;
+#endif
+}
+
+// Multiplies a by b and folds the product, each input bit reaches every output bit
+inline uint64_t hash_mix(uint64_t a, uint64_t b) noexcept {
+    hash_mum(a, b);
+    return a ^ b;
+}
+
+/**
+ * @brief Hash of a 64-bit value, for integers, enums and pointers
+ *
+ * The SplitMix64 finalizer (Stafford's variant 13), a bijection in which
+ * flipping any input bit flips each output bit with probability close to
+ * one half. Unlike the identity std::hash gives integers, sequential and
+ * strided values come out spread over every bit.
+ */
+inline uint64_t hash_int(uint64_t v, uint64_t seed = 0) noexcept {
+    v ^= seed + 0x9E3779B97F4A7C15ULL;
+    v = (v ^ (v >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    v = (v ^ (v >> 27)) * 0x94D049BB133111EBULL;
+    return v ^ (v >> 31);
+}
+
+inline uint64_t hash_read8(const unsigned char *p) noexcept {
+    uint64_t v;
+    std::memcpy(&v, p, 8);
+    return v;
+}
+
+inline uint64_t hash_read4(const unsigned char *p) noexcept {
+    uint32_t v;
+    std::memcpy(&v, p, 4);
+    return v;
+}
+
+/**
+ * @brief wyhash (final version 4) of len bytes at data
+ *
+ * Reads 48 bytes per step in three independent lanes, and inputs of 16
+ * bytes or less with two overlapping loads and no loop.
+ */
+inline uint64_t hash_bytes(const void *data, size_t len, uint64_t seed = 0) noexcept {
+    const unsigned char *p = static_cast<const unsigned char*>(data);
+    uint64_t a, b;
+    seed ^= hash_mix(seed ^ HashSecret[0], HashSecret[1]);
+    if(len <= 16) {
+        if(len >= 4) {
+            size_t mid = (len >> 3) << 2;
+            a = (hash_read4(p) << 32) | hash_read4(p + mid);
+            b = (hash_read4(p + len - 4) << 32) | hash_read4(p + len - 4 - mid);
+        }
+        else if(len > 0) {
+            a = ((uint64_t)p[0] << 16) | ((uint64_t)p[len >> 1] << 8) | p[len - 1];
+            b = 0;
+        }
+        else
+            a = b = 0;
+    }
+    else {
+        size_t i = len;
+        if(i > 48) {
+            uint64_t see1 = seed, see2 = seed;
+            do {
+                seed = hash_mix(hash_read8(p) ^ HashSecret[1], hash_read8(p + 8) ^ seed);
+                see1 = hash_mix(hash_read8(p + 16) ^ HashSecret[2], hash_read8(p + 24) ^ see1);
+                see2 = hash_mix(hash_read8(p + 32) ^ HashSecret[3], hash_read8(p + 40) ^ see2);
+                p += 48;
+                i -= 48;
+            } while(i > 48);
+            seed ^= see1 ^ see2;
+        }
+        while(i > 16) {
+            seed = hash_mix(hash_read8(p) ^ HashSecret[1], hash_read8(p + 8) ^ seed);
+            p += 16;
+            i -= 16;
+        }
+        a = hash_read8(p + i - 16);
+        b = hash_read8(p + i - 8);
+    }
+
+    a ^= HashSecret[1];
+    b ^= seed;
+    hash_mum(a, b);
+    return hash_mix(a ^ HashSecret[0] ^ len, b ^ HashSecret[1]);
+}
+
+// Hash of v folded into seed, order matters so (a, b) and (b, a) differ
+inline size_t hash_combine(size_t seed, size_t v) noexcept {
+    return (size_t)hash_mix(seed ^ HashSecret[2], v ^ HashSecret[3]);
+}
+
+/**
+ * @brief Fresh unpredictable seed, from std::random_device where it works,
+ * the clock, and an address that moves with ASLR
+ */
+inline uint64_t hash_random_seed() {
+    static std::atomic<uint64_t> calls{0};
+    uint64_t s = (uint64_t)std::chrono::steady_clock::now().time_since_epoch().count();
+    s = hash_int(s ^ calls.fetch_add(1, std::memory_order_relaxed),
+                 (uint64_t)reinterpret_cast<uintptr_t>(&calls));
+    try {
+        std::random_device rd;
+        s ^= ((uint64_t)rd() << 32) ^ rd();
+    }
+    catch(...) {}
+
+    return hash_int(s);
+}
+
+// Seed every default constructed Hasher starts from, drawn once per process
+inline uint64_t hash_process_seed() {
+    static const uint64_t seed = hash_random_seed();
+    return seed;
+}
+
+
+/* * * * * * * * * * * * * * * * * * * * * * * * *
+ *
+ *        Hasher Class Declarations
+ *
+ * Default hasher of the map containers, one
+ * specialization per kind of key. Integers,
+ * enums and pointers go through hash_int,
+ * strings through hash_bytes, and Pair and
+ * tuple keys hash_combine their members.
+ * Anything else is hashed with std::hash and
+ * then mixed, since std::hash often does
+ * little more than return its input.
+ *
+ * Every Hasher is seeded, by default with
+ * hash_process_seed(), so which keys collide
+ * differs from run to run and cannot be worked
+ * out ahead of time to flood one bucket.
+ * reseed() changes the seed, which UnorderedMap
+ * uses when a chain grows suspiciously long.
+ *
+ * * * * * * * * * * * * * * * * * * * * * * * * */
+
+/**
+ * @brief Whether hasher F can be given a new seed with reseed(uint64_t)
+ */
+template <typename F, typename = void>
+struct is_reseedable : std::false_type {};
+
+template <typename F>
+struct is_reseedable<F, std::void_t<decltype(std::declval<F&>().reseed(uint64_t()))>>
+    : std::true_type {};
+
+/**
+ * @brief Seed shared by the Hasher specializations
+ */
+struct HashSeed
+{
+    uint64_t seed;
+
+    HashSeed() : seed(hash_process_seed()) {}
+    explicit HashSeed(uint64_t s) noexcept : seed(s) {}
+
+    void reseed(uint64_t s) noexcept { seed = s; }
+};
+
+template <typename T, typename = void>
+struct Hasher : HashSeed
+{
+    using HashSeed::HashSeed;
+
+    size_t operator()(const T& v) const { return (size_t)hash_int(std::hash<T>()(v), seed); }
+};
+
+template <typename T>
+struct Hasher<T, std::enable_if_t<std::is_integral_v<T> || std::is_enum_v<T>>> : HashSeed
+{
+    using HashSeed::HashSeed;
+
+    size_t operator()(T v) const noexcept { return (size_t)hash_int((uint64_t)v, seed); }
+};
+
+template <typename T>
+struct Hasher<T*> : HashSeed
+{
+    using HashSeed::HashSeed;
+
+    size_t operator()(T *p) const noexcept
+        { return (size_t)hash_int((uint64_t)reinterpret_cast<uintptr_t>(p), seed); }
+};
+
+// -0.0 hashes like 0.0 since they compare equal
+template <typename T>
+struct Hasher<T, std::enable_if_t<std::is_floating_point_v<T> && sizeof(T) <= 8>> : HashSeed
+{
+    using HashSeed::HashSeed;
+
+    size_t operator()(T v) const noexcept {
+        uint64_t bits = 0;
+        if(v != 0)
+            std::memcpy(&bits, &v, sizeof(T));
+        return (size_t)hash_int(bits, seed);
+    }
+};
+
+// Transparent, so a map keyed by std::string can be searched by string_view or const char*
+template <typename C, typename Tr, typename A>
+struct Hasher<std::basic_string<C, Tr, A>> : HashSeed
+{
+    typedef void is_transparent;
+    using HashSeed::HashSeed;
+
+    size_t operator()(std::basic_string_view<C, Tr> s) const noexcept
+        { return (size_t)hash_bytes(s.data(), s.size() * sizeof(C), seed); }
+};
+
+template <typename C, typename Tr>
+struct Hasher<std::basic_string_view<C, Tr>> : HashSeed
+{
+    typedef void is_transparent;
+    using HashSeed::HashSeed;
+
+    size_t operator()(std::basic_string_view<C, Tr> s) const noexcept
+        { return (size_t)hash_bytes(s.data(), s.size() * sizeof(C), seed); }
+};
+
+template <typename T1, typename T2>
+struct Hasher<Pair<T1, T2>> : HashSeed
+{
+    using HashSeed::HashSeed;
+
+    size_t operator()(const Pair<T1, T2>& p) const {
+        return hash_combine(Hasher<std::remove_const_t<T1>>(seed)(p.first),
+                            Hasher<std::remove_const_t<T2>>(seed)(p.second));
+    }
+};
+
+template <typename T1, typename T2>
+struct Hasher<std::pair<T1, T2>> : HashSeed
+{
+    using HashSeed::HashSeed;
+
+    size_t operator()(const std::pair<T1, T2>& p) const {
+        return hash_combine(Hasher<std::remove_const_t<T1>>(seed)(p.first),
+                            Hasher<std::remove_const_t<T2>>(seed)(p.second));
+    }
+};
+
+template <typename... Ts>
+struct Hasher<std::tuple<Ts...>> : HashSeed
+{
+    using HashSeed::HashSeed;
+
+    size_t operator()(const std::tuple<Ts...>& t) const {
+        return std::apply([this](const Ts&... v) {
+            size_t h = sizeof...(Ts);
+            ((h = hash_combine(h, Hasher<std::remove_const_t<Ts>>(seed)(v))), ...);
+            return h;
+        }, t);
+    }
+};
+
+
+#endif //_HASHER_H_
@@ -0,0 +1,390 @@
+/**
+ * @file MappedHashMap.h
+ * @author Jackson Brenneman
+ * @brief Read-only hash map served straight from a memory mapped file
+ * @date 2023-11-28
+ *
+ */
+
+#ifndef _MAPPED_HASH_MAP_H_
+#define _MAPPED_HASH_MAP_H_
+
+#include <bit>
+#include <cerrno>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <new>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+#include <type_traits>
+#include <utility>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "Hasher.h"
+#include "Pair.h"
+
+
+/**
+ * @brief First bytes of a MappedHashMap file
+ *
+ * All offsets are from the start of the file, so the file can be mapped
+ * at any address. Sizes are recorded so a file built for other key or
+ * value types, or on a machine of the other byte order, is rejected.
+ */
+struct MappedMapHeader
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t byteOrder;     // ByteOrderMark as written by the builder
+    uint64_t seed;          // seed of the Hasher the file was built with
+    uint64_t size;
+    uint64_t capacity;      // slots, a power of two
+    uint64_t keySize;
+    uint64_t valueSize;
+    uint64_t slotSize;
+    uint64_t tagsOffset;    // capacity bytes, 0 for an empty slot
+    uint64_t slotsOffset;   // capacity slots
+    uint64_t fileSize;
+};
+
+inline constexpr char MappedMapMagic[8] = {'C', 'N', 'T', 'R', 'H', 'M', 'A', 'P'};
+inline constexpr uint32_t MappedMapVersion = 1;
+inline constexpr uint32_t ByteOrderMark = 0x01020304;
+
+
+/* * * * * * * * * * * * * * * * * * * * * * * * *
+ *
+ *       MappedHashMap Class Declaration
+ *
+ * Open addressing table (linear probing over
+ * power of two capacity, Fibonacci hashing)
+ * laid out in a file: header, one tag byte per
+ * slot, then the slots themselves. The map maps
+ * the file read only and looks keys up in place,
+ * so opening costs the same for any size and
+ * every process opening the file shares its
+ * pages through the page cache. Tags hold 7 bits
+ * of the hash with the top bit set, so probes
+ * mostly read the tag bytes only. Key and T must
+ * be trivially copyable, and Hash constructible
+ * from the seed in the header (as Hasher is) and
+ * the same in the builder and every reader.
+ * Files are written with write(), which builds
+ * in a temporary file and renames it into place.
+ * POSIX only.
+ *
+ * * * * * * * * * * * * * * * * * * * * * * * * */
+
+template <typename Key, typename T, typename Hash = Hasher<Key>,
+          typename KeyEqual = std::equal_to<Key>>
+class MappedHashMap
+{
+    static_assert(std::is_trivially_copyable_v<Key> && std::is_trivially_copyable_v<T>,
+                  "MappedHashMap needs trivially copyable keys and values");
+
+    typedef Pair<Key, T> pair;
+
+    static const size_t MinCapacity = 8;
+    static constexpr double MaxLoadFactor = 0.75;
+    static constexpr size_t Align = 64;
+
+    void *base;
+    size_t length;
+    const MappedMapHeader *header;
+    const uint8_t *tags;
+    const pair *slots;
+    size_t mask;
+    unsigned shift;
+    Hash h;
+    KeyEqual eq;
+
+public:
+    explicit MappedHashMap(const std::string& path, const KeyEqual& e = KeyEqual());
+    MappedHashMap(const MappedHashMap&) = delete;
+    MappedHashMap(MappedHashMap&&) noexcept;
+    ~MappedHashMap();
+
+    MappedHashMap& operator=(const MappedHashMap&) = delete;
+
+    bool empty() const noexcept { return size() == 0; }
+    size_t size() const noexcept { return header->size; }
+    size_t bucket_count() const noexcept { return mask + 1; }
+    uint64_t seed() const noexcept { return header->seed; }
+
+    // Value for k inside the mapping, nullptr if k is absent
+    const T* find(const Key&) const;
+    size_t count(const Key& k) const { return (find(k) != nullptr) ? 1 : 0; }
+    bool contains(const Key& k) const { return find(k) != nullptr; }
+    template <typename Fn> void for_each(Fn) const;
+
+    template <typename Map>
+    static void write(const std::string&, const Map&, uint64_t = hash_random_seed(),
+                      const KeyEqual& = KeyEqual());
+
+private:
+    static size_t home(uint64_t hash, unsigned sh) noexcept
+        { return (size_t)((hash * 0x9E3779B97F4A7C15ULL) >> sh); }
+    // Top bit marks the slot used, the low 7 bits come from the hash
+    static uint8_t tag_of(uint64_t hash) noexcept { return (uint8_t)(0x80 | (hash & 0x7F)); }
+    static size_t align_up(size_t n) noexcept { return (n + Align - 1) & ~(Align - 1); }
+    static MappedMapHeader layout(uint64_t size, uint64_t seed);
+    void validate(const std::string&) const;
+};
+
+
+
+
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *            MappedHashMap Class Definitions              *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+/**
+ * Maps the file at path read only and checks its header. Throws
+ * std::system_error if the file cannot be opened or mapped, and
+ * std::runtime_error if it is not a file this map type can read.
+ */
+template <typename Key, typename T, typename H, typename E>
+MappedHashMap<Key,T,H,E>::MappedHashMap(const std::string& path, const E& e)
+    : base(nullptr), length(0), header(nullptr), tags(nullptr), slots(nullptr),
+      mask(0), shift(64), h(0), eq(e) {
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if(fd < 0)
+        throw std::system_error(errno, std::generic_category(), "MappedHashMap: open " + path);
+
+    struct stat st;
+    if(::fstat(fd, &st) != 0) {
+        int err = errno;
+        ::close(fd);
+        throw std::system_error(err, std::generic_category(), "MappedHashMap: stat " + path);
+    }
+    length = (size_t)st.st_size;
+    if(length < sizeof(MappedMapHeader)) {
+        ::close(fd);
+        throw std::runtime_error("MappedHashMap: " + path + " is too short");
+    }
+
+    base = ::mmap(nullptr, length, PROT_READ, MAP_SHARED, fd, 0);
+    int err = errno;
+    ::close(fd);
+    if(base == MAP_FAILED)
+        throw std::system_error(err, std::generic_category(), "MappedHashMap: mmap " + path);
+
+    header = static_cast<const MappedMapHeader*>(base);
+    try {
+        validate(path);
+    }
+    catch(...) {
+        ::munmap(base, length);
+        throw;
+    }
+
+    const char *bytes = static_cast<const char*>(base);
+    tags = reinterpret_cast<const uint8_t*>(bytes + header->tagsOffset);
+    slots = reinterpret_cast<const pair*>(bytes + header->slotsOffset);
+    mask = header->capacity - 1;
+    shift = 64 - std::countr_zero(header->capacity);
+    h = H(header->seed);
+    // Lookups land anywhere in the file, read ahead would only waste I/O
+    ::madvise(base, length, MADV_RANDOM);
+}
+
+// Move constructor, other no longer owns a mapping
+template <typename Key, typename T, typename H, typename E>
+MappedHashMap<Key,T,H,E>::MappedHashMap(MappedHashMap&& other) noexcept
+    : base(other.base), length(other.length), header(other.header), tags(other.tags),
+      slots(other.slots), mask(other.mask), shift(other.shift),
+      h(std::move(other.h)), eq(std::move(other.eq)) {
+    other.base = nullptr;
+    other.length = 0;
+}
+
+template <typename Key, typename T, typename H, typename E>
+MappedHashMap<Key,T,H,E>::~MappedHashMap() {
+    if(base != nullptr)
+        ::munmap(base, length);
+}
+
+/**
+ * Probes tag bytes and only reads a slot when its tag matches. A file from
+ * write() always has an empty tag, but the probe still stops after one pass
+ * over the table so a corrupt file with every tag set cannot loop forever.
+ */
+template <typename Key, typename T, typename H, typename E>
+const T* MappedHashMap<Key,T,H,E>::find(const Key& k) const {
+    uint64_t hash = h(k);
+    uint8_t t = tag_of(hash);
+    size_t i = home(hash, shift);
+    for(size_t n = 0; n <= mask && tags[i] != 0; n++, i = (i + 1) & mask)
+        if(tags[i] == t && eq(slots[i].first, k))
+            return &slots[i].second;
+
+    return nullptr;
+}
+
+// Calls fn(const Key&, const T&) for every pair, in slot order
+template <typename Key, typename T, typename H, typename E>
+template <typename Fn>
+void MappedHashMap<Key,T,H,E>::for_each(Fn fn) const {
+    for(size_t i = 0; i <= mask; i++)
+        if(tags[i] != 0)
+            fn(slots[i].first, slots[i].second);
+}
+
+/**
+ * Writes every pair of m (anything with cbegin() and cend() over pairs,
+ * such as UnorderedMap or DenseMap) to path as a file readers can
+ * map, hashed with H(seed) and compared with e, which should match the
+ * KeyEqual readers are given. The table is filled through a shared mapping
+ * of a temporary file made by mkstemp next to path, which is synced and
+ * then renamed over path, so readers never see a partial file and
+ * concurrent writers never share a temporary. The directory holding path is synced
+ * after the rename, so the new file survives a crash once write returns.
+ * Later duplicates of a key are dropped.
+ */
+template <typename Key, typename T, typename H, typename E>
+template <typename Map>
+void MappedHashMap<Key,T,H,E>::write(const std::string& path, const Map& m, uint64_t seed,
+                                     const E& e) {
+    MappedMapHeader head = layout(m.size(), seed);
+    std::string temp = path + ".XXXXXX";
+    int fd = ::mkstemp(temp.data());
+    if(fd < 0)
+        throw std::system_error(errno, std::generic_category(), "MappedHashMap: mkstemp " + temp);
+
+    void *out = MAP_FAILED;
+    auto fail = [&](const char *what) {
+        int err = errno;
+        if(out != MAP_FAILED)
+            ::munmap(out, head.fileSize);
+        ::close(fd);
+        ::unlink(temp.c_str());
+        throw std::system_error(err, std::generic_category(),
+                                std::string("MappedHashMap: ") + what + " " + temp);
+    };
+
+    // mkstemp makes the file private to its owner, readers may be other users
+    if(::fcntl(fd, F_SETFD, FD_CLOEXEC) != 0 || ::fchmod(fd, 0644) != 0)
+        fail("chmod");
+    // The new file reads as zeros, so every tag starts out empty
+    if(::ftruncate(fd, (off_t)head.fileSize) != 0)
+        fail("truncate");
+    out = ::mmap(nullptr, head.fileSize, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if(out == MAP_FAILED)
+        fail("mmap");
+
+    char *bytes = static_cast<char*>(out);
+    uint8_t *outTags = reinterpret_cast<uint8_t*>(bytes + head.tagsOffset);
+    pair *outSlots = reinterpret_cast<pair*>(bytes + head.slotsOffset);
+    size_t outMask = head.capacity - 1;
+    unsigned outShift = 64 - std::countr_zero(head.capacity);
+    H hs(seed);
+    uint64_t stored = 0;
+    for(auto it = m.cbegin(); it != m.cend(); ++it) {
+        const auto& p = *it;
+        uint64_t hash = hs(p.first);
+        uint8_t t = tag_of(hash);
+        size_t i = home(hash, outShift);
+        while(outTags[i] != 0 && !(outTags[i] == t && e(outSlots[i].first, p.first)))
+            i = (i + 1) & outMask;
+        if(outTags[i] != 0)
+            continue;
+
+        new (outSlots + i) pair(p.first, p.second);
+        outTags[i] = t;
+        stored++;
+    }
+    head.size = stored;
+    std::memcpy(bytes, &head, sizeof(head));
+
+    if(::msync(out, head.fileSize, MS_SYNC) != 0)
+        fail("msync");
+    ::munmap(out, head.fileSize);
+    out = MAP_FAILED;
+    if(::close(fd) != 0) {
+        int err = errno;
+        ::unlink(temp.c_str());
+        throw std::system_error(err, std::generic_category(), "MappedHashMap: close " + temp);
+    }
+    if(::rename(temp.c_str(), path.c_str()) != 0) {
+        int err = errno;
+        ::unlink(temp.c_str());
+        throw std::system_error(err, std::generic_category(), "MappedHashMap: rename " + temp);
+    }
+
+    size_t slash = path.find_last_of('/');
+    std::string dir = slash == std::string::npos ? "." : path.substr(0, slash + 1);
+    int dfd = ::open(dir.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if(dfd < 0)
+        throw std::system_error(errno, std::generic_category(), "MappedHashMap: open " + dir);
+    if(::fsync(dfd) != 0) {
+        int err = errno;
+        ::close(dfd);
+        throw std::system_error(err, std::generic_category(), "MappedHashMap: fsync " + dir);
+    }
+    ::close(dfd);
+}
+
+// Header for a file holding size pairs, at most MaxLoadFactor full
+template <typename Key, typename T, typename H, typename E>
+MappedMapHeader MappedHashMap<Key,T,H,E>::layout(uint64_t size, uint64_t seed) {
+    uint64_t capacity = (uint64_t)std::ceil(size / MaxLoadFactor) + 1;
+    capacity = std::bit_ceil(capacity < MinCapacity ? (uint64_t)MinCapacity : capacity);
+
+    MappedMapHeader head;
+    std::memset(&head, 0, sizeof(head));
+    std::memcpy(head.magic, MappedMapMagic, sizeof(head.magic));
+    head.version = MappedMapVersion;
+    head.byteOrder = ByteOrderMark;
+    head.seed = seed;
+    head.size = size;
+    head.capacity = capacity;
+    head.keySize = sizeof(Key);
+    head.valueSize = sizeof(T);
+    head.slotSize = sizeof(pair);
+    head.tagsOffset = align_up(sizeof(MappedMapHeader));
+    head.slotsOffset = align_up(head.tagsOffset + capacity);
+    head.fileSize = head.slotsOffset + capacity * sizeof(pair);
+
+    return head;
+}
+
+// Throws std::runtime_error unless the mapped header describes this map type
+template <typename Key, typename T, typename H, typename E>
+void MappedHashMap<Key,T,H,E>::validate(const std::string& path) const {
+    auto reject = [&path](const char *why) {
+        throw std::runtime_error("MappedHashMap: " + path + ": " + why);
+    };
+
+    if(std::memcmp(header->magic, MappedMapMagic, sizeof(header->magic)) != 0)
+        reject("not a mapped hash map file");
+    if(header->byteOrder != ByteOrderMark)
+        reject("written with the other byte order");
+    if(header->version != MappedMapVersion)
+        reject("unsupported format version");
+    if(header->keySize != sizeof(Key) || header->valueSize != sizeof(T) ||
+       header->slotSize != sizeof(pair))
+        reject("key or value type does not match");
+
+    uint64_t cap = header->capacity;
+    if(cap < MinCapacity || !std::has_single_bit(cap) || header->size >= cap)
+        reject("bad capacity");
+    if(header->tagsOffset % Align != 0 || header->slotsOffset % Align != 0 ||
+       header->tagsOffset < sizeof(MappedMapHeader) ||
+       header->slotsOffset < header->tagsOffset + cap ||
+       header->fileSize != header->slotsOffset + cap * sizeof(pair) ||
+       header->fileSize > length)
+        reject("truncated or corrupt layout");
+}
+
+
+#endif //_MAPPED_HASH_MAP_H_
@@ -0,0 +1,61 @@
+/**
+ * @file Pair.h
+ * @author Jackson Brenneman
+ * @brief Key/value pair used by the map containers
+ * @date 2023-11-05
+ *
+ */
+
+#ifndef _PAIR_H_
+#define _PAIR_H_
+
+#include <iostream>
+#include <tuple>
+#include <utility>
+
+using std::ostream;
+
+
+/**
+ * @brief Pair structure to group two objects (often key and value)
+ *
+ * @tparam T1 first object type
+ * @tparam T2 second object type
+ */
+template <typename T1, typename T2>
+struct Pair
+{
+    T1 first;
+    T2 second;
+
+    Pair(const T1& f = T1(), const T2& s = T2()) : first(f), second(s) {}
+    template <typename U1, typename U2> Pair(U1&& f, U2&& s)
+        : first(std::forward<U1>(f)), second(std::forward<U2>(s)) {}
+    // Builds first and second in place from the tuple arguments
+    template <typename... Args1, typename... Args2>
+    Pair(std::piecewise_construct_t, std::tuple<Args1...> f, std::tuple<Args2...> s)
+        : first(std::make_from_tuple<T1>(std::move(f))),
+          second(std::make_from_tuple<T2>(std::move(s))) {}
+    Pair(const Pair& other) = default;
+    Pair(Pair&& p) = default;
+
+    Pair& operator=(const Pair&) = default;
+    Pair& operator=(Pair&&) = default;
+
+    bool operator==(const Pair& rhs) const noexcept
+        { return first == rhs.first; }
+    bool operator!=(const Pair& rhs) const noexcept
+        { return !(first == rhs.first); }
+
+    template <typename F, typename G>
+    friend ostream& operator<<(ostream&, const Pair<F,G>&);
+};
+
+template<typename F, typename G>
+ostream& operator<<(ostream & os, const Pair<F,G> &p) {
+    os << "(" << p.first << ", " << p.second << ") ";
+
+    return os;
+}
+
+#endif //_PAIR_H_
@@ -0,0 +1,270 @@
+/**
+ * @file PersistentList.h
+ * @author Jackson Brenneman
+ * @brief Immutable singly linked list with shared tails
+ * @date 2023-11-14
+ *
+ */
+
+#ifndef _PERSISTENT_LIST_H_
+#define _PERSISTENT_LIST_H_
+
+#include <atomic>
+#include <iostream>
+#include <stdexcept>
+
+#include "ForwardList.h"
+
+using std::ostream;
+using std::out_of_range;
+
+
+/**
+ * @brief Reference count safe to share between threads
+ */
+struct AtomicRefCount
+{
+    std::atomic<size_t> n;
+
+    AtomicRefCount() : n(1) {}
+
+    void acquire() noexcept { n.fetch_add(1, std::memory_order_relaxed); }
+    bool release() noexcept { return n.fetch_sub(1, std::memory_order_acq_rel) == 1; }
+    size_t count() const noexcept { return n.load(std::memory_order_relaxed); }
+};
+
+/**
+ * @brief Plain reference count for lists used by a single thread
+ */
+struct LocalRefCount
+{
+    size_t n;
+
+    LocalRefCount() : n(1) {}
+
+    void acquire() noexcept { n++; }
+    bool release() noexcept { return --n == 0; }
+    size_t count() const noexcept { return n; }
+};
+
+
+/* * * * * * * * * * * * * * * * * * * * * * * * *
+ *
+ *      PersistentList Class Declaration
+ *
+ * Singly linked list whose nodes are never changed
+ * once built. Every version shares its tail with
+ * the version it was made from, so copies, cons
+ * and tail are O(1) and only new heads allocate.
+ * Nodes are reference counted and freed when the
+ * last version using them goes away.
+ *
+ * * * * * * * * * * * * * * * * * * * * * * * * */
+
+template <typename T, typename RefCount = AtomicRefCount>
+class PersistentList
+{
+    struct PNode
+    {
+        const T data;
+        PNode *const next;
+        mutable RefCount refs;
+
+        PNode(const T& d, PNode *p) : data(d), next(p) {}
+        PNode(T&& d, PNode *p) : data(std::move(d)), next(p) {}
+    };
+
+    class List_Iterator;
+
+    PNode *head;
+    size_t _size;
+
+public:
+    typedef List_Iterator const_iterator;
+    typedef List_Iterator iterator;
+
+    PersistentList() : head(nullptr), _size(0) {}
+    explicit PersistentList(const ForwardList<T>&);
+    PersistentList(const PersistentList& rhs) : head(share(rhs.head)), _size(rhs._size) {}
+    PersistentList(PersistentList&& rhs) noexcept : head(rhs.head), _size(rhs._size)
+        { rhs.head = nullptr; rhs._size = 0; }
+    ~PersistentList() { release(head); }
+
+    PersistentList& operator=(const PersistentList&);
+    PersistentList& operator=(PersistentList&&) noexcept;
+
+    const T& front() const;
+
+    const_iterator begin() const noexcept { return const_iterator(head); }
+    const_iterator end() const noexcept { return const_iterator(nullptr); }
+    const_iterator cbegin() const noexcept { return const_iterator(head); }
+    const_iterator cend() const noexcept { return const_iterator(nullptr); }
+
+    bool empty() const noexcept { return head == nullptr; }
+    size_t size() const noexcept { return _size; }
+
+    // Number of versions sharing the first node
+    size_t use_count() const noexcept { return head ? head->refs.count() : 0; }
+
+    PersistentList cons(const T&) const;
+    PersistentList cons(T&&) const;
+    PersistentList tail() const;
+
+    void push_front(const T& val) { *this = cons(val); }
+    void push_front(T&& val) { *this = cons(std::move(val)); }
+    void pop_front();
+    void clear() noexcept { release(head); head = nullptr; _size = 0; }
+
+private:
+    PersistentList(PNode *n, size_t sz) : head(n), _size(sz) {}
+
+    static PNode* share(PNode *n) noexcept { if(n) n->refs.acquire(); return n; }
+    static void release(PNode*) noexcept;
+
+    class List_Iterator
+    {
+    public:
+        List_Iterator(const PNode *ptr) { current = ptr; }
+
+        const T& operator*() const { return current->data; }
+        const T* operator->() const { return &(current->data); }
+
+        List_Iterator& operator++() { current = current->next; return *this; }
+        List_Iterator operator++(int)
+            { List_Iterator temp(current); current = current->next; return temp; }
+
+        bool operator==(const List_Iterator &rhs) const noexcept
+            { return this->current == rhs.current; }
+        bool operator!=(const List_Iterator &rhs) const noexcept
+            { return !(*this == rhs); }
+
+    private:
+        const PNode *current;
+    };
+
+public:
+    template <typename F, typename R>
+    friend ostream& operator<<(ostream&, const PersistentList<F,R>&);
+};
+
+
+
+
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *            PersistentList Class Definitions             *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+// Builds a list with the same order as lst
+template <typename T, typename R>
+PersistentList<T,R>::PersistentList(const ForwardList<T>& lst) : head(nullptr), _size(0) {
+    if(lst.empty())
+        return;
+
+    // Nodes are immutable, so build back to front from a reversed copy
+    ForwardList<T> reversed;
+    for(auto itr = lst.cbegin(); itr != lst.cend(); ++itr)
+        reversed.push_front(*itr);
+
+    for(auto itr = reversed.cbegin(); itr != reversed.cend(); ++itr) {
+        head = new PNode(*itr, head);
+        _size++;
+    }
+}
+
+// Copy assignment, shares rhs
+template <typename T, typename R>
+PersistentList<T,R>& PersistentList<T,R>::operator=(const PersistentList& rhs) {
+    PNode *old = head;
+    head = share(rhs.head);
+    _size = rhs._size;
+    release(old);
+
+    return *this;
+}
+
+// Move assignment
+template <typename T, typename R>
+PersistentList<T,R>& PersistentList<T,R>::operator=(PersistentList&& rhs) noexcept {
+    if(this == &rhs)
+        return *this;
+
+    release(head);
+    head = rhs.head;
+    _size = rhs._size;
+    rhs.head = nullptr;
+    rhs._size = 0;
+
+    return *this;
+}
+
+// First element, throws if list is empty
+template <typename T, typename R>
+const T& PersistentList<T,R>::front() const {
+    if(empty())
+        throw out_of_range("ERROR: front called on empty list");
+
+    return head->data;
+}
+
+// Returns a new version with val in front of this one
+template <typename T, typename R>
+PersistentList<T,R> PersistentList<T,R>::cons(const T& val) const {
+    PNode *n = new PNode(val, head);
+    share(head);
+
+    return PersistentList(n, _size + 1);
+}
+
+// Returns a new version with val in front of this one
+template <typename T, typename R>
+PersistentList<T,R> PersistentList<T,R>::cons(T&& val) const {
+    PNode *n = new PNode(std::move(val), head);
+    share(head);
+
+    return PersistentList(n, _size + 1);
+}
+
+// Returns this version without its first element
+template <typename T, typename R>
+PersistentList<T,R> PersistentList<T,R>::tail() const {
+    if(empty())
+        throw out_of_range("ERROR: tail called on empty list");
+
+    return PersistentList(share(head->next), _size - 1);
+}
+
+// Drops the first element from this version only
+template <typename T, typename R>
+void PersistentList<T,R>::pop_front() {
+    if(empty())
+        throw out_of_range("ERROR: pop_front called on empty list");
+
+    PNode *old = head;
+    head = share(head->next);
+    _size--;
+    release(old);
+}
+
+// Frees nodes no longer used by any version, iterative for long lists
+template <typename T, typename R>
+void PersistentList<T,R>::release(PNode *n) noexcept {
+    while(n != nullptr && n->refs.release()) {
+        PNode *next = n->next;
+        delete n;
+        n = next;
+    }
+}
+
+
+template <typename F, typename R>
+ostream& operator<<(ostream &os, const PersistentList<F,R> &rhs) {
+    auto itr = rhs.cbegin();
+    while(itr != rhs.cend()) {
+        os << *itr << " ";
+        ++itr;
+    }
+    return os;
+}
+
+
+#endif //_PERSISTENT_LIST_H_
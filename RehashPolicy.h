@@ -0,0 +1,146 @@
+/**
+ * @file RehashPolicy.h
+ * @author Jackson Brenneman
+ * @brief Bucket sizing policies for UnorderedMap
+ * @date 2023-11-22
+ *
+ */
+
+#ifndef _REHASH_POLICY_H_
+#define _REHASH_POLICY_H_
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+
+
+/**
+ * @brief Bucket counts for PrimeRehashPolicy
+ *
+ * Smallest prime >= 2^k for k = 1..63, so each step roughly doubles.
+ */
+inline constexpr uint64_t PrimeBucketCounts[] = {
+    2ULL, 5ULL, 11ULL, 17ULL,
+    37ULL, 67ULL, 131ULL, 257ULL,
+    521ULL, 1031ULL, 2053ULL, 4099ULL,
+    8209ULL, 16411ULL, 32771ULL, 65537ULL,
+    131101ULL, 262147ULL, 524309ULL, 1048583ULL,
+    2097169ULL, 4194319ULL, 8388617ULL, 16777259ULL,
+    33554467ULL, 67108879ULL, 134217757ULL, 268435459ULL,
+    536870923ULL, 1073741827ULL, 2147483659ULL, 4294967311ULL,
+    8589934609ULL, 17179869209ULL, 34359738421ULL, 68719476767ULL,
+    137438953481ULL, 274877906951ULL, 549755813911ULL, 1099511627791ULL,
+    2199023255579ULL, 4398046511119ULL, 8796093022237ULL, 17592186044423ULL,
+    35184372088891ULL, 70368744177679ULL, 140737488355333ULL, 281474976710677ULL,
+    562949953421381ULL, 1125899906842679ULL, 2251799813685269ULL, 4503599627370517ULL,
+    9007199254740997ULL, 18014398509482143ULL, 36028797018963971ULL, 72057594037928017ULL,
+    144115188075855881ULL, 288230376151711813ULL, 576460752303423619ULL, 1152921504606847009ULL,
+    2305843009213693967ULL, 4611686018427388039ULL, 9223372036854775837ULL
+};
+
+inline constexpr size_t PrimeBucketCountsSize =
+    sizeof(PrimeBucketCounts) / sizeof(PrimeBucketCounts[0]);
+
+#if defined(__SIZEOF_INT128__)
+/**
+ * @brief Lemire fastmod multipliers, ceil(2^128 / p) for each prime p
+ *
+ * With M = ceil(2^128 / d), a % d is the high 64 bits of the low 128
+ * bits of M * a, times d. Exact for every 64-bit a and d > 1.
+ */
+inline constexpr auto PrimeFastmodMagic = [] {
+    std::array<unsigned __int128, PrimeBucketCountsSize> m{};
+    for(size_t i = 0; i < PrimeBucketCountsSize; i++)
+        m[i] = ~(unsigned __int128)0 / PrimeBucketCounts[i] + 1;
+    return m;
+}();
+
+inline uint64_t fastmod_u64(uint64_t a, unsigned __int128 M, uint64_t d) noexcept {
+    unsigned __int128 lowbits = M * a;
+    unsigned __int128 bottom = ((lowbits & ~(uint64_t)0) * d) >> 64;
+    unsigned __int128 top = (lowbits >> 64) * d;
+    return (uint64_t)((bottom + top) >> 64);
+}
+#endif
+
+
+/**
+ * @brief Prime bucket counts, bucket index is hash % bucket count
+ *
+ * A prime count spreads keys well even when the hash is weak (such as
+ * the identity hash std::hash uses for integers). Counts come from
+ * PrimeBucketCounts, and where 128-bit integers are available the
+ * modulo is a Lemire fastmod with the prime's precomputed multiplier.
+ */
+struct PrimeRehashPolicy
+{
+    size_t buckets = 2;
+#if defined(__SIZEOF_INT128__)
+    unsigned __int128 magic = PrimeFastmodMagic[0];
+#endif
+
+    // Smallest supported bucket count >= n
+    size_t next_bucket_count(size_t n) const;
+    // Must be called with the bucket count in use
+    void reset(size_t count) noexcept;
+    size_t index(size_t hash) const noexcept {
+#if defined(__SIZEOF_INT128__)
+        return fastmod_u64(hash, magic, buckets);
+#else
+        return hash % buckets;
+#endif
+    }
+};
+
+/**
+ * @brief Power of two bucket counts with Fibonacci hashing
+ *
+ * The bucket index is the top bits of hash * 2^64 / phi, a multiply
+ * and a shift instead of a division. The multiply mixes every input
+ * bit into the index, so sequential and strided keys do not collide
+ * the way they would under a plain mask.
+ */
+struct PowerOfTwoRehashPolicy
+{
+    unsigned shift = 63;
+
+    // Smallest supported bucket count >= n
+    size_t next_bucket_count(size_t n) const
+        { return n < 2 ? 2 : std::bit_ceil(n); }
+    // Must be called with the bucket count in use, a power of two
+    void reset(size_t count) noexcept { shift = 64 - std::countr_zero(count); }
+    size_t index(size_t hash) const noexcept
+        { return (size_t)(((uint64_t)hash * 0x9E3779B97F4A7C15ULL) >> shift); }
+};
+
+
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *           PrimeRehashPolicy Definitions                 *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+// First table prime >= n, the largest prime if n is past the table
+inline size_t PrimeRehashPolicy::next_bucket_count(size_t n) const {
+    const uint64_t *last = PrimeBucketCounts + PrimeBucketCountsSize;
+    const uint64_t *p = std::lower_bound(PrimeBucketCounts, last, (uint64_t)n);
+    if(p == last)
+        --p;
+
+    return (size_t)*p;
+}
+
+inline void PrimeRehashPolicy::reset(size_t count) noexcept {
+    buckets = count;
+#if defined(__SIZEOF_INT128__)
+    const uint64_t *last = PrimeBucketCounts + PrimeBucketCountsSize;
+    const uint64_t *p = std::lower_bound(PrimeBucketCounts, last, (uint64_t)count);
+    if(p != last && *p == count)
+        magic = PrimeFastmodMagic[p - PrimeBucketCounts];
+    else
+        magic = ~(unsigned __int128)0 / count + 1;
+#endif
+}
+
+
+#endif //_REHASH_POLICY_H_
@@ -0,0 +1,600 @@
+/**
+ * @file RobinHoodMap.h
+ * @author Jackson Brenneman
+ * @brief Robin Hood hash table with backward shift deletion
+ * @date 2023-11-20
+ *
+ */
+
+#ifndef _ROBIN_HOOD_MAP_H_
+#define _ROBIN_HOOD_MAP_H_
+
+#include <bit>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <iterator>
+#include <new>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+
+#include "Hasher.h"
+#include "Pair.h"
+#include "Vector.h"
+
+
+/**
+ * @brief Displacement distribution of a RobinHoodMap
+ *
+ * histogram[d] is the number of pairs stored d slots past their home
+ * slot. A failed lookup stops after at most max + 1 probes.
+ */
+struct ProbeStats
+{
+    size_t max;
+    double mean;
+    Vector<size_t> histogram;
+};
+
+
+/* * * * * * * * * * * * * * * * * * * * * * * * *
+ *
+ *        RobinHoodMap Class Declaration
+ *
+ * Open addressing map with linear probing where
+ * an insert takes the slot of any pair closer to
+ * its home than the new one (Robin Hood hashing).
+ * One byte per slot records displacement + 1, so
+ * a lookup stops as soon as it passes a pair that
+ * is closer to home than the key would be. Erase
+ * shifts the following run back one slot, so no
+ * tombstones are left. Probes never wrap: the
+ * slot array has an overflow area past the last
+ * home slot and the table grows if it fills.
+ * More than 255 keys sharing one hash value
+ * cannot be stored, and no amount of growth
+ * separates them: once the table is sparse and
+ * a run still overflows, a reseedable hasher
+ * (such as the default Hasher) gets a fresh
+ * random seed, and any other hasher makes the
+ * insert throw std::length_error. Default max
+ * load factor is 0.9.
+ *
+ * * * * * * * * * * * * * * * * * * * * * * * * */
+
+template <typename Key, typename T, typename Hash = Hasher<Key>>
+class RobinHoodMap
+{
+    typedef Pair<const Key, T> pair;
+
+    template <typename val_type>
+    class Robin_Iterator;
+
+    static const size_t MinCapacity = 8;
+    static const size_t MaxDist = 255;
+
+    pair *slots;
+    uint8_t *dist;
+    size_t capacity;
+    size_t slotCount;
+    unsigned shift;
+    size_t currentSize;
+    Hash h;
+    float _max_load_factor;
+
+public:
+    typedef Robin_Iterator<pair> iterator;
+    typedef Robin_Iterator<const pair> const_iterator;
+
+    RobinHoodMap() : RobinHoodMap(0) {}
+    RobinHoodMap(size_t n, const Hash& hs = Hash());
+    RobinHoodMap(const RobinHoodMap&);
+    RobinHoodMap(RobinHoodMap&&) noexcept;
+    ~RobinHoodMap();
+
+    RobinHoodMap& operator=(const RobinHoodMap&);
+    RobinHoodMap& operator=(RobinHoodMap&&) noexcept;
+
+          iterator begin() noexcept { return make_iterator(0); }
+    const_iterator begin() const noexcept { return cbegin(); }
+    const_iterator cbegin() const noexcept { return make_const_iterator(0); }
+          iterator end() noexcept { return make_iterator(slotCount); }
+    const_iterator end() const noexcept { return cend(); }
+    const_iterator cend() const noexcept { return make_const_iterator(slotCount); }
+
+    bool empty() const noexcept { return currentSize == 0; }
+    size_t size() const noexcept { return currentSize; }
+
+    void clear() noexcept;
+    Pair<iterator, bool> insert(const pair&);
+    Pair<iterator, bool> insert(pair&&);
+    iterator erase(const_iterator);
+    size_t erase(const Key&);
+
+    T& operator[](const Key&);
+    iterator find(const Key&);
+    const_iterator find(const Key&) const;
+    size_t count(const Key& k) const { return (find(k) != cend()) ? 1 : 0; }
+
+    size_t bucket_count() const noexcept { return capacity; }
+    float load_factor() const
+        { return capacity ? (float)currentSize / (float)capacity : 0.0f; }
+    float max_load_factor() const { return _max_load_factor; }
+    void max_load_factor(float);
+    void rehash(size_t);
+    void reserve(size_t n) { rehash(std::ceil(n / max_load_factor())); }
+
+    ProbeStats probe_stats() const;
+
+private:
+    // Fibonacci hashing, top bits of hash * 2^64 / phi
+    size_t home(const Key& k) const
+        { return (size_t)(((uint64_t)h(k) * 0x9E3779B97F4A7C15ULL) >> shift); }
+
+    size_t find_index(const Key&) const;
+    template <typename... Args> size_t emplace_new(Args&&...);
+    size_t place(size_t, pair&);
+    void split_collisions(bool&);
+    void resize(size_t);
+    void allocate(size_t);
+    void destroy_all() noexcept;
+    void release() noexcept;
+
+    iterator make_iterator(size_t ndx) noexcept
+        { return iterator(dist + ndx, slots + ndx, dist + slotCount); }
+    const_iterator make_const_iterator(size_t ndx) const noexcept
+        { return const_iterator(dist + ndx, slots + ndx, dist + slotCount); }
+
+    template <typename val_type>
+    class Robin_Iterator
+    {
+    public:
+        typedef std::forward_iterator_tag iterator_category;
+        typedef std::remove_const_t<val_type> value_type;
+        typedef std::ptrdiff_t difference_type;
+        typedef val_type* pointer;
+        typedef val_type& reference;
+
+        Robin_Iterator() : meta(nullptr), slot(nullptr), last(nullptr) {}
+        template <typename V,
+                  typename = std::enable_if_t<std::is_convertible_v<V*, val_type*>>>
+        Robin_Iterator(const Robin_Iterator<V>& it)
+            : meta(it.meta), slot(it.slot), last(it.last) {}
+
+        reference operator*() const { return *slot; }
+        pointer operator->() const { return slot; }
+
+        Robin_Iterator& operator++() { ++meta; ++slot; skip(); return *this; }
+        Robin_Iterator operator++(int)
+            { Robin_Iterator temp = *this; ++(*this); return temp; }
+
+        bool operator==(const Robin_Iterator& rhs) const noexcept
+            { return meta == rhs.meta; }
+        bool operator!=(const Robin_Iterator& rhs) const noexcept
+            { return !(*this == rhs); }
+
+    private:
+        const uint8_t *meta;
+        val_type *slot;
+        const uint8_t *last;
+
+        Robin_Iterator(const uint8_t *m, val_type *s, const uint8_t *l)
+            : meta(m), slot(s), last(l) { skip(); }
+
+        void skip() { while(meta != last && *meta == 0) { ++meta; ++slot; } }
+
+        template <typename> friend class Robin_Iterator;
+        friend class RobinHoodMap;
+    };
+
+public:
+    template <typename F, typename G, typename I>
+    friend ostream& operator<<(ostream&, const RobinHoodMap<F,G,I>&);
+};
+
+
+
+
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *             RobinHoodMap Class Definitions              *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+// Constructor, room for at least n pairs before growing
+template <typename Key, typename T, typename H>
+RobinHoodMap<Key,T,H>::RobinHoodMap(size_t n, const H& hs)
+    : slots(nullptr), dist(nullptr), capacity(0), slotCount(0), shift(64),
+      currentSize(0), h(hs), _max_load_factor(0.9) {
+    if(n > 0)
+        reserve(n);
+}
+
+// Copy constructor, keeps the layout of other
+template <typename Key, typename T, typename H>
+RobinHoodMap<Key,T,H>::RobinHoodMap(const RobinHoodMap& other)
+    : slots(nullptr), dist(nullptr), capacity(0), slotCount(0), shift(64),
+      currentSize(0), h(other.h), _max_load_factor(other._max_load_factor) {
+    if(other.capacity == 0)
+        return;
+
+    allocate(other.capacity);
+    for(size_t i = 0; i < slotCount; i++) {
+        if(other.dist[i] == 0)
+            continue;
+        new (slots + i) pair(other.slots[i]);
+        dist[i] = other.dist[i];
+        currentSize++;
+    }
+}
+
+// Move constructor
+template <typename Key, typename T, typename H>
+RobinHoodMap<Key,T,H>::RobinHoodMap(RobinHoodMap&& other) noexcept
+    : slots(other.slots), dist(other.dist), capacity(other.capacity),
+      slotCount(other.slotCount), shift(other.shift),
+      currentSize(other.currentSize), h(std::move(other.h)),
+      _max_load_factor(other._max_load_factor) {
+    other.slots = nullptr;
+    other.dist = nullptr;
+    other.capacity = 0;
+    other.slotCount = 0;
+    other.shift = 64;
+    other.currentSize = 0;
+}
+
+template <typename Key, typename T, typename H>
+RobinHoodMap<Key,T,H>::~RobinHoodMap() {
+    destroy_all();
+    release();
+}
+
+// Copy assignment
+template <typename Key, typename T, typename H>
+RobinHoodMap<Key,T,H>& RobinHoodMap<Key,T,H>::operator=(const RobinHoodMap& other) {
+    if(this == &other)
+        return *this;
+
+    RobinHoodMap temp(other);
+    return *this = std::move(temp);
+}
+
+// Move assignment
+template <typename Key, typename T, typename H>
+RobinHoodMap<Key,T,H>& RobinHoodMap<Key,T,H>::operator=(RobinHoodMap&& other) noexcept {
+    if(this == &other)
+        return *this;
+
+    destroy_all();
+    release();
+
+    slots = other.slots;
+    dist = other.dist;
+    capacity = other.capacity;
+    slotCount = other.slotCount;
+    shift = other.shift;
+    currentSize = other.currentSize;
+    h = std::move(other.h);
+    _max_load_factor = other._max_load_factor;
+
+    other.slots = nullptr;
+    other.dist = nullptr;
+    other.capacity = 0;
+    other.slotCount = 0;
+    other.shift = 64;
+    other.currentSize = 0;
+
+    return *this;
+}
+
+// Destroys all pairs, capacity is kept
+template <typename Key, typename T, typename H>
+void RobinHoodMap<Key,T,H>::clear() noexcept {
+    destroy_all();
+    if(slotCount > 0)
+        std::memset(dist, 0, slotCount);
+    currentSize = 0;
+}
+
+// Insert pair, return iterator to pair and bool if inserted
+template <typename Key, typename T, typename H>
+auto RobinHoodMap<Key,T,H>::insert(const pair& p) -> Pair<iterator, bool> {
+    size_t ndx = find_index(p.first);
+    if(ndx != slotCount)
+        return Pair<iterator, bool>(make_iterator(ndx), false);
+
+    return Pair<iterator, bool>(make_iterator(emplace_new(p)), true);
+}
+
+// Move insert
+template <typename Key, typename T, typename H>
+auto RobinHoodMap<Key,T,H>::insert(pair&& p) -> Pair<iterator, bool> {
+    size_t ndx = find_index(p.first);
+    if(ndx != slotCount)
+        return Pair<iterator, bool>(make_iterator(ndx), false);
+
+    return Pair<iterator, bool>(make_iterator(emplace_new(std::move(p))), true);
+}
+
+/**
+ * Erase pair at itr by shifting the rest of its run back one slot.
+ * Returns iterator to the pair that followed it.
+ */
+template <typename Key, typename T, typename H>
+auto RobinHoodMap<Key,T,H>::erase(const_iterator itr) -> iterator {
+    size_t i = itr.meta - dist;
+    slots[i].~pair();
+
+    size_t j = i + 1;
+    while(j < slotCount && dist[j] > 1) {
+        new (slots + j - 1) pair(std::move(slots[j]));
+        slots[j].~pair();
+        dist[j - 1] = dist[j] - 1;
+        j++;
+    }
+    dist[j - 1] = 0;
+    currentSize--;
+
+    return make_iterator(i);
+}
+
+// Erase pair with key k, return number of pairs erased
+template <typename Key, typename T, typename H>
+size_t RobinHoodMap<Key,T,H>::erase(const Key& k) {
+    size_t ndx = find_index(k);
+    if(ndx == slotCount)
+        return 0;
+
+    erase(make_const_iterator(ndx));
+    return 1;
+}
+
+// Subscript operator
+template <typename Key, typename T, typename H>
+T& RobinHoodMap<Key,T,H>::operator[](const Key& k) {
+    size_t ndx = find_index(k);
+    if(ndx == slotCount)
+        ndx = emplace_new(k, T());
+
+    return slots[ndx].second;
+}
+
+// Return iterator to key if found, else end()
+template <typename Key, typename T, typename H>
+auto RobinHoodMap<Key,T,H>::find(const Key& k) -> iterator {
+    return make_iterator(find_index(k));
+}
+
+// Return const_iterator to key if found, else cend()
+template <typename Key, typename T, typename H>
+auto RobinHoodMap<Key,T,H>::find(const Key& k) const -> const_iterator {
+    return make_const_iterator(find_index(k));
+}
+
+// Sets max load factor, kept below 1 so runs stay short
+template <typename Key, typename T, typename H>
+void RobinHoodMap<Key,T,H>::max_load_factor(float ml) {
+    if(ml <= 0.0f || ml > 0.95f)
+        ml = 0.95f;
+    _max_load_factor = ml;
+
+    if(currentSize > capacity * _max_load_factor)
+        rehash(0);
+}
+
+// Rehash to at least n home slots, n > size() / max_load_factor()
+template <typename Key, typename T, typename H>
+void RobinHoodMap<Key,T,H>::rehash(size_t n) {
+    size_t need = (size_t)std::ceil(currentSize / max_load_factor());
+    if(n < need)
+        n = need;
+    if(n == 0) {
+        destroy_all();
+        release();
+        return;
+    }
+    if(n < MinCapacity)
+        n = MinCapacity;
+
+    resize(std::bit_ceil(n));
+}
+
+// Histogram of displacement over all pairs
+template <typename Key, typename T, typename H>
+ProbeStats RobinHoodMap<Key,T,H>::probe_stats() const {
+    size_t longest = 0;
+    size_t total = 0;
+    for(size_t i = 0; i < slotCount; i++) {
+        if(dist[i] == 0)
+            continue;
+        size_t d = dist[i] - 1;
+        total += d;
+        if(d > longest)
+            longest = d;
+    }
+
+    Vector<size_t> histogram(longest + 1, 0);
+    for(size_t i = 0; i < slotCount; i++)
+        if(dist[i] != 0)
+            histogram[dist[i] - 1]++;
+
+    double mean = currentSize ? (double)total / (double)currentSize : 0.0;
+    return ProbeStats{longest, mean, std::move(histogram)};
+}
+
+// Index of the slot holding k, or slotCount if absent
+template <typename Key, typename T, typename H>
+size_t RobinHoodMap<Key,T,H>::find_index(const Key& k) const {
+    if(capacity == 0)
+        return slotCount;
+
+    size_t i = home(k);
+    for(unsigned d = 1; dist[i] >= d; i++, d++) {
+        // Only a pair with the same home can hold the same key
+        if(dist[i] == d && slots[i].first == k)
+            return i;
+    }
+
+    return slotCount;
+}
+
+/**
+ * Builds a pair for a key known to be absent and stores it, growing
+ * first if the load factor or the overflow area would be exceeded.
+ * Doubling stops once the table is under an eighth of its max load,
+ * since a run that still overflows then is keys sharing one hash.
+ * Returns the index of the new pair.
+ */
+template <typename Key, typename T, typename H>
+template <typename... Args>
+size_t RobinHoodMap<Key,T,H>::emplace_new(Args&&... args) {
+    pair cur(std::forward<Args>(args)...);
+
+    if(currentSize + 1 > capacity * _max_load_factor)
+        resize(capacity ? capacity * 2 : MinCapacity);
+
+    size_t ndx;
+    bool reseeded = false;
+    while((ndx = place(home(cur.first), cur)) == slotCount) {
+        if(currentSize * 8 >= capacity * _max_load_factor)
+            resize(capacity * 2);
+        else
+            split_collisions(reseeded);
+    }
+    currentSize++;
+
+    return ndx;
+}
+
+// Gives a reseedable hasher one new seed and rebuilds the table, throws
+// std::length_error if that was already tried or the hasher has no seed
+template <typename Key, typename T, typename H>
+void RobinHoodMap<Key,T,H>::split_collisions(bool& reseeded) {
+    if constexpr (is_reseedable<H>::value) {
+        if(!reseeded) {
+            h.reseed(hash_random_seed());
+            resize(capacity);
+            reseeded = true;
+            return;
+        }
+    }
+    (void)reseeded;
+    throw std::length_error("RobinHoodMap: more than 255 keys share a hash value");
+}
+
+/**
+ * Moves p into the table starting from its home slot i. The pairs
+ * from the insertion point up to the next empty slot shift right by
+ * one. Returns the index of p, or slotCount with the table untouched
+ * if the run would leave the slot array or a displacement would not
+ * fit in a byte.
+ */
+template <typename Key, typename T, typename H>
+size_t RobinHoodMap<Key,T,H>::place(size_t i, pair& p) {
+    unsigned d = 1;
+    while(i < slotCount && dist[i] >= d) {
+        i++;
+        d++;
+    }
+    if(i == slotCount || d > MaxDist)
+        return slotCount;
+
+    size_t e = i;
+    while(e < slotCount && dist[e] != 0) {
+        if(dist[e] == MaxDist)
+            return slotCount;
+        e++;
+    }
+    if(e == slotCount)
+        return slotCount;
+
+    for(size_t j = e; j > i; j--) {
+        new (slots + j) pair(std::move(slots[j - 1]));
+        slots[j - 1].~pair();
+        dist[j] = dist[j - 1] + 1;
+    }
+    new (slots + i) pair(std::move(p));
+    dist[i] = d;
+
+    return i;
+}
+
+/**
+ * Moves every pair into a table with cap home slots. If a run does not
+ * fit the overflow area the partly built table is itself doubled.
+ */
+template <typename Key, typename T, typename H>
+void RobinHoodMap<Key,T,H>::resize(size_t cap) {
+    pair *oldSlots = slots;
+    uint8_t *oldDist = dist;
+    size_t oldCount = slotCount;
+
+    allocate(cap);
+    for(size_t i = 0; i < oldCount; i++) {
+        if(oldDist[i] == 0)
+            continue;
+        while(place(home(oldSlots[i].first), oldSlots[i]) == slotCount)
+            resize(capacity * 2);
+        oldSlots[i].~pair();
+    }
+
+    if(oldCount > 0) {
+        ::operator delete(oldSlots, std::align_val_t(alignof(pair)));
+        delete[] oldDist;
+    }
+}
+
+// Allocates empty arrays for cap home slots plus the overflow area
+template <typename Key, typename T, typename H>
+void RobinHoodMap<Key,T,H>::allocate(size_t cap) {
+    size_t count = cap + (cap < MaxDist ? cap : MaxDist);
+    dist = new uint8_t[count]();
+    try {
+        slots = static_cast<pair*>(
+            ::operator new(count * sizeof(pair), std::align_val_t(alignof(pair))));
+    }
+    catch(...) {
+        delete[] dist;
+        throw;
+    }
+
+    capacity = cap;
+    slotCount = count;
+    shift = 64 - std::countr_zero(cap);
+}
+
+template <typename Key, typename T, typename H>
+void RobinHoodMap<Key,T,H>::destroy_all() noexcept {
+    if(!std::is_trivially_destructible_v<pair>) {
+        for(size_t i = 0; i < slotCount; i++)
+            if(dist[i] != 0)
+                slots[i].~pair();
+    }
+}
+
+// Frees both arrays, pairs must already be destroyed
+template <typename Key, typename T, typename H>
+void RobinHoodMap<Key,T,H>::release() noexcept {
+    if(slotCount > 0) {
+        ::operator delete(slots, std::align_val_t(alignof(pair)));
+        delete[] dist;
+    }
+    slots = nullptr;
+    dist = nullptr;
+    capacity = 0;
+    slotCount = 0;
+    shift = 64;
+    currentSize = 0;
+}
+
+
+template <typename F, typename G, typename I>
+ostream& operator<<(ostream &os, const RobinHoodMap<F,G,I>& rhs) {
+    for(auto itr = rhs.cbegin(); itr != rhs.cend(); ++itr)
+        os << *itr;
+    return os;
+}
+
+
+#endif //_ROBIN_HOOD_MAP_H_
@@ -0,0 +1,812 @@
+/**
+ * @file SkipList.h
+ * @author Jackson Brenneman
+ * @brief Ordered map built on a skip list
+ * @date 2023-11-12
+ *
+ */
+
+#ifndef _SKIP_LIST_H_
+#define _SKIP_LIST_H_
+
+#include <atomic>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <iterator>
+#include <mutex>
+#include <new>
+#include <type_traits>
+
+#include "ForwardList.h"
+#include "Pair.h"
+
+
+/**
+ * @brief Pool of skip list towers
+ *
+ * Every node and its tower of links are carved out of one block. Blocks
+ * come from large chunks and are recycled through one free list per
+ * tower height, so inserts after an erase do not touch the allocator.
+ *
+ * @tparam NodeType node type, provides static size_t bytes(unsigned height)
+ */
+template <typename NodeType>
+class TowerPool
+{
+    static const unsigned MaxHeight = 32;
+    static const size_t ChunkSize = 64 * 1024;
+
+    struct Block { Block *next; };
+
+    Block *freeList[MaxHeight];
+    Block *chunks;
+    char *cursor;
+    char *limit;
+
+public:
+    TowerPool() : chunks(nullptr), cursor(nullptr), limit(nullptr)
+        { for(unsigned i = 0; i < MaxHeight; i++) freeList[i] = nullptr; }
+    TowerPool(const TowerPool&) = delete;
+    ~TowerPool();
+
+    TowerPool& operator=(const TowerPool&) = delete;
+
+    void* allocate(unsigned height);
+    void deallocate(void *p, unsigned height) noexcept;
+    void swap(TowerPool&) noexcept;
+
+private:
+    static size_t block_size(unsigned height) {
+        size_t n = NodeType::bytes(height);
+        if(n < sizeof(Block)) n = sizeof(Block);
+        return (n + alignof(NodeType) - 1) / alignof(NodeType) * alignof(NodeType);
+    }
+    static size_t header_size() {
+        return (sizeof(Block) + alignof(NodeType) - 1) / alignof(NodeType) * alignof(NodeType);
+    }
+};
+
+
+/* * * * * * * * * * * * * * * * * * * * * * * * *
+ *
+ *          SkipList Class Declaration
+ *
+ * Ordered map similar to std::map. Level 0 of the
+ * skip list is an ordinary Node<T> chain linked
+ * through Node::next, so the bottom of the list
+ * can be walked like a ForwardList. Higher levels
+ * are stored in the same pool block as the node.
+ * find, insert and erase are expected O(log n).
+ *
+ * * * * * * * * * * * * * * * * * * * * * * * * */
+
+template <typename Key, typename T, typename Compare = std::less<Key>>
+class SkipList
+{
+    typedef Pair<const Key, T> pair;
+    typedef Node<pair> node;
+
+    template <typename val_type, typename ptr_type>
+    class Skip_Iterator;
+
+    // Level 0 link is node::next, levels 1..height-1 follow the node
+    struct tower_node : node
+    {
+        unsigned height;
+        node **tower;
+
+        tower_node(const pair& d, unsigned h, node **t)
+            : node(d), height(h), tower(t) {}
+        tower_node(pair&& d, unsigned h, node **t)
+            : node(std::move(d)), height(h), tower(t) {}
+
+        static size_t bytes(unsigned h)
+            { return sizeof(tower_node) + (h - 1) * sizeof(node*); }
+    };
+
+    static const unsigned MaxLevel = 32;
+
+    node *head[MaxLevel];
+    unsigned level;
+    size_t _size;
+    uint64_t seed;
+    Compare comp;
+    TowerPool<tower_node> pool;
+
+public:
+    typedef Skip_Iterator<pair, node*> iterator;
+    typedef Skip_Iterator<const pair, const node*> const_iterator;
+
+    SkipList(const Compare& c = Compare());
+    SkipList(const SkipList&);
+    SkipList(SkipList&&);
+    ~SkipList() { clear(); }
+
+    SkipList& operator=(const SkipList&);
+    SkipList& operator=(SkipList&&);
+
+          iterator begin() noexcept { return iterator(head[0]); }
+          iterator end() noexcept { return iterator(NULL); }
+    const_iterator begin() const noexcept { return const_iterator(head[0]); }
+    const_iterator end() const noexcept { return const_iterator(NULL); }
+    const_iterator cbegin() const noexcept { return const_iterator(head[0]); }
+    const_iterator cend() const noexcept { return const_iterator(NULL); }
+
+    // Bottom level chain, ordered by key
+    const node* chain() const noexcept { return head[0]; }
+
+    bool empty() const noexcept { return _size == 0; }
+    size_t size() const noexcept { return _size; }
+
+    void clear() noexcept;
+    Pair<iterator, bool> insert(const pair&);
+    Pair<iterator, bool> insert(pair&&);
+    iterator erase(const_iterator);
+    size_t erase(const Key&);
+
+    T& operator[](const Key&);
+    iterator find(const Key&);
+    const_iterator find(const Key&) const;
+    size_t count(const Key& k) const { return (find(k) != cend()) ? 1 : 0; }
+
+    iterator lower_bound(const Key& k) { return iterator(search(k)); }
+    const_iterator lower_bound(const Key& k) const { return const_iterator(search(k)); }
+    iterator upper_bound(const Key&);
+    const_iterator upper_bound(const Key&) const;
+
+private:
+    node*& link(node *x, unsigned lvl) const {
+        if(x == nullptr) return const_cast<node*&>(head[lvl]);
+        if(lvl == 0) return x->next;
+        return static_cast<tower_node*>(x)->tower[lvl - 1];
+    }
+
+    node* search(const Key&, node ***update = nullptr) const;
+    template <typename P> Pair<iterator, bool> insert_node(P&&);
+    template <typename P> tower_node* create_node(unsigned, P&&);
+    void destroy_node(node*) noexcept;
+    void unlink(node*, node ***update);
+    unsigned random_height();
+    void copy_from(const SkipList&);
+    void move_from(SkipList&) noexcept;
+
+    template <typename val_type, typename ptr_type>
+    class Skip_Iterator
+    {
+    public:
+        typedef std::forward_iterator_tag iterator_category;
+        typedef std::remove_const_t<val_type> value_type;
+        typedef std::ptrdiff_t difference_type;
+        typedef val_type* pointer;
+        typedef val_type& reference;
+
+        Skip_Iterator() : current(NULL) {}
+        Skip_Iterator(ptr_type ptr) { current = ptr; }
+
+        // iterator converts to const_iterator, not the other way
+        template <typename V, typename P,
+                  typename = std::enable_if_t<std::is_convertible_v<P, ptr_type>>>
+        Skip_Iterator(const Skip_Iterator<V, P>& it) { current = it.current; }
+
+        val_type& operator*() { return current->data; }
+        val_type* operator->() { return &(current->data); }
+        const val_type& operator*() const { return current->data; }
+        const val_type* operator->() const { return &(current->data); }
+
+        Skip_Iterator& operator++() { current = current->next; return *this; }
+        Skip_Iterator operator++(int)
+            { Skip_Iterator temp(current); current = current->next; return temp; }
+
+        bool operator==(const Skip_Iterator &rhs) const noexcept
+            { return this->current == rhs.current; }
+        bool operator!=(const Skip_Iterator &rhs) const noexcept
+            { return !(*this == rhs); }
+
+    private:
+        ptr_type current;
+
+        template <typename, typename> friend class Skip_Iterator;
+        friend class SkipList;
+    };
+
+public:
+    template <typename F, typename G, typename C>
+    friend ostream& operator<<(ostream&, const SkipList<F,G,C>&);
+};
+
+
+/* * * * * * * * * * * * * * * * * * * * * * * * *
+ *
+ *      ConcurrentSkipList Class Declaration
+ *
+ * Skip list for read-mostly use. Readers never
+ * lock: links are atomics published with release
+ * stores after a node is fully built. Writers are
+ * serialized by a mutex. Erased nodes are kept on
+ * a retired list until reclaim() is called at a
+ * point where no reader is inside the list.
+ *
+ * * * * * * * * * * * * * * * * * * * * * * * * */
+
+template <typename Key, typename T, typename Compare = std::less<Key>>
+class ConcurrentSkipList
+{
+    typedef Pair<const Key, T> pair;
+
+    // All levels live in the tower that follows the node
+    struct cnode
+    {
+        pair data;
+        unsigned height;
+        cnode *retired;
+        std::atomic<cnode*> *tower;
+
+        cnode(const pair& d, unsigned h, std::atomic<cnode*> *t)
+            : data(d), height(h), retired(nullptr), tower(t) {}
+
+        static size_t bytes(unsigned h)
+            { return sizeof(cnode) + h * sizeof(std::atomic<cnode*>); }
+    };
+
+    static const unsigned MaxLevel = 32;
+
+    std::atomic<cnode*> head[MaxLevel];
+    std::atomic<unsigned> level;
+    std::atomic<size_t> _size;
+    cnode *retiredList;
+    uint64_t seed;
+    Compare comp;
+    TowerPool<cnode> pool;
+    mutable std::mutex writeLock;
+
+public:
+    ConcurrentSkipList(const Compare& c = Compare());
+    ConcurrentSkipList(const ConcurrentSkipList&) = delete;
+    ~ConcurrentSkipList();
+
+    ConcurrentSkipList& operator=(const ConcurrentSkipList&) = delete;
+
+    bool empty() const noexcept { return size() == 0; }
+    size_t size() const noexcept { return _size.load(std::memory_order_relaxed); }
+
+    // Readers, safe alongside one another and alongside writers
+    bool find(const Key&, T&) const;
+    bool contains(const Key&) const;
+    template <typename Fn> void for_each(const Key&, const Key&, Fn) const;
+
+    // Writers
+    bool insert(const pair&);
+    size_t erase(const Key&);
+    void reclaim() noexcept;
+
+private:
+    cnode* search(const Key&, std::atomic<cnode*> **update = nullptr) const;
+    unsigned random_height();
+};
+
+
+
+
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *              TowerPool Class Definitions                *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+// Releases every chunk, blocks still in use must be destroyed first
+template <typename NodeType>
+TowerPool<NodeType>::~TowerPool() {
+    while(chunks != nullptr) {
+        Block *next = chunks->next;
+        ::operator delete(chunks, std::align_val_t(alignof(NodeType)));
+        chunks = next;
+    }
+}
+
+// Returns raw storage for a node with height levels
+template <typename NodeType>
+void* TowerPool<NodeType>::allocate(unsigned height) {
+    if(freeList[height - 1] != nullptr) {
+        Block *b = freeList[height - 1];
+        freeList[height - 1] = b->next;
+        return b;
+    }
+
+    size_t n = block_size(height);
+    if(cursor == nullptr || (size_t)(limit - cursor) < n) {
+        size_t bytes = header_size() + (ChunkSize > n ? ChunkSize : n);
+        Block *chunk = static_cast<Block*>(
+            ::operator new(bytes, std::align_val_t(alignof(NodeType))));
+        chunk->next = chunks;
+        chunks = chunk;
+        cursor = reinterpret_cast<char*>(chunk) + header_size();
+        limit = reinterpret_cast<char*>(chunk) + bytes;
+    }
+
+    void *p = cursor;
+    cursor += n;
+    return p;
+}
+
+// Returns storage to the free list for its height
+template <typename NodeType>
+void TowerPool<NodeType>::deallocate(void *p, unsigned height) noexcept {
+    Block *b = static_cast<Block*>(p);
+    b->next = freeList[height - 1];
+    freeList[height - 1] = b;
+}
+
+template <typename NodeType>
+void TowerPool<NodeType>::swap(TowerPool& other) noexcept {
+    for(unsigned i = 0; i < MaxHeight; i++)
+        std::swap(freeList[i], other.freeList[i]);
+    std::swap(chunks, other.chunks);
+    std::swap(cursor, other.cursor);
+    std::swap(limit, other.limit);
+}
+
+
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *              SkipList Class Definitions                 *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+// Default constructor
+template <typename Key, typename T, typename C>
+SkipList<Key,T,C>::SkipList(const C& c)
+    : level(1), _size(0), seed(0x9E3779B97F4A7C15ULL), comp(c) {
+    for(unsigned i = 0; i < MaxLevel; i++)
+        head[i] = nullptr;
+}
+
+// Copy constructor
+template <typename Key, typename T, typename C>
+SkipList<Key,T,C>::SkipList(const SkipList& rhs) : SkipList(rhs.comp) {
+    copy_from(rhs);
+}
+
+// Move constructor
+template <typename Key, typename T, typename C>
+SkipList<Key,T,C>::SkipList(SkipList&& rhs) : SkipList(rhs.comp) {
+    move_from(rhs);
+}
+
+// Overloaded assignment copy
+template <typename Key, typename T, typename C>
+SkipList<Key,T,C>& SkipList<Key,T,C>::operator=(const SkipList& rhs) {
+    if(this == &rhs)
+        return *this;
+
+    clear();
+    comp = rhs.comp;
+    copy_from(rhs);
+
+    return *this;
+}
+
+// Move assignment
+template <typename Key, typename T, typename C>
+SkipList<Key,T,C>& SkipList<Key,T,C>::operator=(SkipList&& rhs) {
+    if(this == &rhs)
+        return *this;
+
+    clear();
+    comp = std::move(rhs.comp);
+    move_from(rhs);
+
+    return *this;
+}
+
+// Destroys all nodes, pool chunks are kept for reuse
+template <typename Key, typename T, typename C>
+void SkipList<Key,T,C>::clear() noexcept {
+    node *ptr = head[0];
+    while(ptr != nullptr) {
+        node *next = ptr->next;
+        destroy_node(ptr);
+        ptr = next;
+    }
+
+    for(unsigned i = 0; i < MaxLevel; i++)
+        head[i] = nullptr;
+    level = 1;
+    _size = 0;
+}
+
+// Insert pair, return iterator to pair and bool if inserted
+template <typename Key, typename T, typename C>
+auto SkipList<Key,T,C>::insert(const pair& p) -> Pair<iterator, bool> {
+    return insert_node(p);
+}
+
+// Move insert
+template <typename Key, typename T, typename C>
+auto SkipList<Key,T,C>::insert(pair&& p) -> Pair<iterator, bool> {
+    return insert_node(std::move(p));
+}
+
+// Removes pair at itr, returns iterator to the following pair
+template <typename Key, typename T, typename C>
+auto SkipList<Key,T,C>::erase(const_iterator itr) -> iterator {
+    node **update[MaxLevel];
+    node *x = search(itr->first, update);
+    node *next = x->next;
+
+    unlink(x, update);
+    return iterator(next);
+}
+
+// Removes the pair with key k, returns number of pairs removed
+template <typename Key, typename T, typename C>
+size_t SkipList<Key,T,C>::erase(const Key& k) {
+    node **update[MaxLevel];
+    node *x = search(k, update);
+    if(x == nullptr || comp(k, x->data.first))
+        return 0;
+
+    unlink(x, update);
+    return 1;
+}
+
+// Subscript operator
+template <typename Key, typename T, typename C>
+T& SkipList<Key,T,C>::operator[](const Key& k) {
+    node *x = search(k);
+    if(x != nullptr && !comp(k, x->data.first))
+        return x->data.second;
+
+    return insert_node(pair(k, T())).first->second;
+}
+
+// Return iterator to key if found, else end()
+template <typename Key, typename T, typename C>
+auto SkipList<Key,T,C>::find(const Key& k) -> iterator {
+    node *x = search(k);
+    if(x == nullptr || comp(k, x->data.first))
+        return end();
+
+    return iterator(x);
+}
+
+// Return const_iterator to key if found, else cend()
+template <typename Key, typename T, typename C>
+auto SkipList<Key,T,C>::find(const Key& k) const -> const_iterator {
+    node *x = search(k);
+    if(x == nullptr || comp(k, x->data.first))
+        return cend();
+
+    return const_iterator(x);
+}
+
+// Return iterator to first key greater than k
+template <typename Key, typename T, typename C>
+auto SkipList<Key,T,C>::upper_bound(const Key& k) -> iterator {
+    node *x = search(k);
+    if(x != nullptr && !comp(k, x->data.first))
+        x = x->next;
+
+    return iterator(x);
+}
+
+// Return const_iterator to first key greater than k
+template <typename Key, typename T, typename C>
+auto SkipList<Key,T,C>::upper_bound(const Key& k) const -> const_iterator {
+    node *x = search(k);
+    if(x != nullptr && !comp(k, x->data.first))
+        x = x->next;
+
+    return const_iterator(x);
+}
+
+/**
+ * Returns the first node with key >= k. If update is given, update[i]
+ * is set to the level i link that points at that position.
+ */
+template <typename Key, typename T, typename C>
+auto SkipList<Key,T,C>::search(const Key& k, node ***update) const -> node* {
+    node *x = nullptr;
+    for(unsigned i = level; i-- > 0;) {
+        node *next;
+        while((next = link(x, i)) != nullptr && comp(next->data.first, k))
+            x = next;
+        if(update != nullptr)
+            update[i] = &link(x, i);
+    }
+
+    return link(x, 0);
+}
+
+// Links a new node in front of the first key >= p.first
+template <typename Key, typename T, typename C>
+template <typename P>
+auto SkipList<Key,T,C>::insert_node(P&& p) -> Pair<iterator, bool> {
+    node **update[MaxLevel];
+    node *x = search(p.first, update);
+    if(x != nullptr && !comp(p.first, x->data.first))
+        return Pair<iterator, bool>(iterator(x), false);
+
+    unsigned h = random_height();
+    tower_node *n = create_node(h, std::forward<P>(p));
+    if(h > level) {
+        for(unsigned i = level; i < h; i++)
+            update[i] = &head[i];
+        level = h;
+    }
+
+    for(unsigned i = 0; i < h; i++) {
+        link(n, i) = *update[i];
+        *update[i] = n;
+    }
+    _size++;
+
+    return Pair<iterator, bool>(iterator(n), true);
+}
+
+// Builds a node and its tower in one pool block
+template <typename Key, typename T, typename C>
+template <typename P>
+auto SkipList<Key,T,C>::create_node(unsigned h, P&& p) -> tower_node* {
+    void *mem = pool.allocate(h);
+    node **tower = reinterpret_cast<node**>(
+        static_cast<char*>(mem) + sizeof(tower_node));
+    try {
+        return new (mem) tower_node(std::forward<P>(p), h, tower);
+    }
+    catch(...) {
+        pool.deallocate(mem, h);
+        throw;
+    }
+}
+
+template <typename Key, typename T, typename C>
+void SkipList<Key,T,C>::destroy_node(node *x) noexcept {
+    tower_node *n = static_cast<tower_node*>(x);
+    unsigned h = n->height;
+    n->~tower_node();
+    pool.deallocate(n, h);
+}
+
+// Unlinks x using the links found by search, then frees it
+template <typename Key, typename T, typename C>
+void SkipList<Key,T,C>::unlink(node *x, node ***update) {
+    unsigned h = static_cast<tower_node*>(x)->height;
+    for(unsigned i = 0; i < h; i++)
+        *update[i] = link(x, i);
+
+    while(level > 1 && head[level - 1] == nullptr)
+        level--;
+
+    destroy_node(x);
+    _size--;
+}
+
+// Geometric height with p = 1/4, from an xorshift64* generator
+template <typename Key, typename T, typename C>
+unsigned SkipList<Key,T,C>::random_height() {
+    seed ^= seed >> 12;
+    seed ^= seed << 25;
+    seed ^= seed >> 27;
+    uint64_t r = seed * 0x2545F4914F6CDD1DULL;
+
+    return 1 + std::countr_zero(r | (1ULL << 62)) / 2;
+}
+
+// Appends a copy of every pair in rhs, keys are already in order
+template <typename Key, typename T, typename C>
+void SkipList<Key,T,C>::copy_from(const SkipList& rhs) {
+    node **tail[MaxLevel];
+    for(unsigned i = 0; i < MaxLevel; i++)
+        tail[i] = &head[i];
+
+    for(const node *ptr = rhs.head[0]; ptr != nullptr; ptr = ptr->next) {
+        unsigned h = random_height();
+        tower_node *n = create_node(h, ptr->data);
+        for(unsigned i = 0; i < h; i++) {
+            link(n, i) = nullptr;
+            *tail[i] = n;
+            tail[i] = &link(n, i);
+        }
+        if(h > level)
+            level = h;
+        _size++;
+    }
+}
+
+// Takes the nodes and the pool of rhs, leaves rhs empty
+template <typename Key, typename T, typename C>
+void SkipList<Key,T,C>::move_from(SkipList& rhs) noexcept {
+    for(unsigned i = 0; i < MaxLevel; i++) {
+        head[i] = rhs.head[i];
+        rhs.head[i] = nullptr;
+    }
+    level = rhs.level;
+    _size = rhs._size;
+    rhs.level = 1;
+    rhs._size = 0;
+    pool.swap(rhs.pool);
+}
+
+
+template <typename F, typename G, typename C>
+ostream& operator<<(ostream &os, const SkipList<F,G,C> &rhs) {
+    auto itr = rhs.cbegin();
+    while(itr != rhs.cend()) {
+        os << *itr;
+        ++itr;
+    }
+    return os;
+}
+
+
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *          ConcurrentSkipList Class Definitions           *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+// Default constructor
+template <typename Key, typename T, typename C>
+ConcurrentSkipList<Key,T,C>::ConcurrentSkipList(const C& c)
+    : level(1), _size(0), retiredList(nullptr),
+      seed(0x9E3779B97F4A7C15ULL), comp(c) {
+    for(unsigned i = 0; i < MaxLevel; i++)
+        head[i].store(nullptr, std::memory_order_relaxed);
+}
+
+// Destructor, no reader may be active
+template <typename Key, typename T, typename C>
+ConcurrentSkipList<Key,T,C>::~ConcurrentSkipList() {
+    reclaim();
+
+    cnode *ptr = head[0].load(std::memory_order_relaxed);
+    while(ptr != nullptr) {
+        cnode *next = ptr->tower[0].load(std::memory_order_relaxed);
+        unsigned h = ptr->height;
+        ptr->~cnode();
+        pool.deallocate(ptr, h);
+        ptr = next;
+    }
+}
+
+// Copies the value for k into out, returns false if k is absent
+template <typename Key, typename T, typename C>
+bool ConcurrentSkipList<Key,T,C>::find(const Key& k, T& out) const {
+    cnode *x = search(k);
+    if(x == nullptr || comp(k, x->data.first))
+        return false;
+
+    out = x->data.second;
+    return true;
+}
+
+template <typename Key, typename T, typename C>
+bool ConcurrentSkipList<Key,T,C>::contains(const Key& k) const {
+    cnode *x = search(k);
+    return x != nullptr && !comp(k, x->data.first);
+}
+
+// Calls fn on every pair with lo <= key < hi, in key order
+template <typename Key, typename T, typename C>
+template <typename Fn>
+void ConcurrentSkipList<Key,T,C>::for_each(const Key& lo, const Key& hi, Fn fn) const {
+    cnode *x = search(lo);
+    while(x != nullptr && comp(x->data.first, hi)) {
+        fn(static_cast<const pair&>(x->data));
+        x = x->tower[0].load(std::memory_order_acquire);
+    }
+}
+
+// Inserts p if its key is absent, returns true if inserted
+template <typename Key, typename T, typename C>
+bool ConcurrentSkipList<Key,T,C>::insert(const pair& p) {
+    std::lock_guard<std::mutex> guard(writeLock);
+
+    std::atomic<cnode*> *update[MaxLevel];
+    cnode *x = search(p.first, update);
+    if(x != nullptr && !comp(p.first, x->data.first))
+        return false;
+
+    unsigned h = random_height();
+    unsigned top = level.load(std::memory_order_relaxed);
+    for(unsigned i = top; i < h; i++)
+        update[i] = &head[i];
+
+    void *mem = pool.allocate(h);
+    auto *tower = reinterpret_cast<std::atomic<cnode*>*>(
+        static_cast<char*>(mem) + sizeof(cnode));
+    cnode *n;
+    try {
+        n = new (mem) cnode(p, h, tower);
+    }
+    catch(...) {
+        pool.deallocate(mem, h);
+        throw;
+    }
+
+    // Fully link the new node before any reader can reach it
+    for(unsigned i = 0; i < h; i++)
+        new (&tower[i]) std::atomic<cnode*>(update[i]->load(std::memory_order_relaxed));
+    for(unsigned i = 0; i < h; i++)
+        update[i]->store(n, std::memory_order_release);
+
+    if(h > top)
+        level.store(h, std::memory_order_release);
+    _size.fetch_add(1, std::memory_order_relaxed);
+
+    return true;
+}
+
+// Unlinks k top down, the node is retired until reclaim()
+template <typename Key, typename T, typename C>
+size_t ConcurrentSkipList<Key,T,C>::erase(const Key& k) {
+    std::lock_guard<std::mutex> guard(writeLock);
+
+    std::atomic<cnode*> *update[MaxLevel];
+    cnode *x = search(k, update);
+    if(x == nullptr || comp(k, x->data.first))
+        return 0;
+
+    for(unsigned i = x->height; i-- > 0;)
+        update[i]->store(x->tower[i].load(std::memory_order_relaxed),
+                         std::memory_order_release);
+
+    unsigned top = level.load(std::memory_order_relaxed);
+    while(top > 1 && head[top - 1].load(std::memory_order_relaxed) == nullptr)
+        top--;
+    level.store(top, std::memory_order_release);
+
+    x->retired = retiredList;
+    retiredList = x;
+    _size.fetch_sub(1, std::memory_order_relaxed);
+
+    return 1;
+}
+
+/**
+ * Frees erased nodes. The caller must ensure no reader that started
+ * before the matching erase is still walking the list.
+ */
+template <typename Key, typename T, typename C>
+void ConcurrentSkipList<Key,T,C>::reclaim() noexcept {
+    std::lock_guard<std::mutex> guard(writeLock);
+
+    while(retiredList != nullptr) {
+        cnode *next = retiredList->retired;
+        unsigned h = retiredList->height;
+        retiredList->~cnode();
+        pool.deallocate(retiredList, h);
+        retiredList = next;
+    }
+}
+
+// Returns the first node with key >= k, see SkipList::search
+template <typename Key, typename T, typename C>
+auto ConcurrentSkipList<Key,T,C>::search(
+    const Key& k,
+    std::atomic<cnode*> **update
+) const -> cnode* {
+    // Return the level 0 successor that was compared, a second load
+    // could observe a node inserted in front of it with a smaller key
+    const std::atomic<cnode*> *links = head;
+    cnode *next = nullptr;
+    for(unsigned i = level.load(std::memory_order_acquire); i-- > 0;) {
+        while((next = links[i].load(std::memory_order_acquire)) != nullptr
+              && comp(next->data.first, k))
+            links = next->tower;
+        if(update != nullptr)
+            update[i] = const_cast<std::atomic<cnode*>*>(&links[i]);
+    }
+
+    return next;
+}
+
+// Same distribution as SkipList::random_height, called under writeLock
+template <typename Key, typename T, typename C>
+unsigned ConcurrentSkipList<Key,T,C>::random_height() {
+    seed ^= seed >> 12;
+    seed ^= seed << 25;
+    seed ^= seed >> 27;
+    uint64_t r = seed * 0x2545F4914F6CDD1DULL;
+
+    return 1 + std::countr_zero(r | (1ULL << 62)) / 2;
+}
+
+
+#endif //_SKIP_LIST_H_
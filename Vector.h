@@ -9,8 +9,12 @@
 #ifndef _VECTOR_H_
 #define _VECTOR_H_
 
+#include <cstddef>
 #include <iostream>
+#include <iterator>
 #include <stdexcept>
+#include <type_traits>
+#include <utility>
 
 using std::ostream;
 using std::endl;
@@ -96,6 +100,12 @@ private:
     class Iterator 
     {
     public:
+        typedef std::bidirectional_iterator_tag iterator_category;
+        typedef std::remove_const_t<val_type> value_type;
+        typedef std::ptrdiff_t difference_type;
+        typedef val_type* pointer;
+        typedef val_type& reference;
+
         Iterator() { current = NULL; }
         Iterator(ptr_type ptr) { current = ptr;}
 
@@ -231,7 +241,7 @@ void Vector<T>::shrink_to_fit(){
         currentCapacity = currentSize;
         T* temp = new T[currentCapacity];
         for(size_t i = 0; i < currentSize; i++)
-            temp[i] = _data[i];
+            temp[i] = std::move(_data[i]);
         if(_data != NULL)
             delete[] _data;
         _data = temp;
@@ -353,7 +363,7 @@ void Vector<T>::increaseCapacity(size_t cap) {
         currentCapacity = cap;
         T* temp = new T[currentCapacity];
         for(size_t i = 0; i < currentSize; i++)
-            temp[i] = _data[i];
+            temp[i] = std::move(_data[i]);
         if(_data != NULL)
             delete[] _data;
         _data = temp;
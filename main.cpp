@@ -2,8 +2,12 @@
 #include <string>
 #include <utility>
 #include <unordered_map>
+#include "FlatHashMap.h"
 #include "HashMap.h"
 
+// Sends every key to the same group, so keys past the 16th overflow
+struct SameGroupHash { size_t operator()(int) const { return 0; } };
+
 int main() {
     std::unordered_map<int, std::string> stdMap;
     UnorderedMap<int, std::string> map;
@@ -14,5 +18,18 @@ int main() {
     std::cout << "stdMap[2]: " << stdMap[2] << std::endl;
     std::cout << "map[2]: " << map[2] << std::endl;
 
+    // A copy must keep the tombstone left by erasing from a full group,
+    // or the key that overflowed past it can no longer be found
+    FlatHashMap<int, int, SameGroupHash> flat(16);
+    for(int i = 0; i < 17; i++)
+        flat[i] = i;
+    flat.erase(3);
+    FlatHashMap<int, int, SameGroupHash> flatCopy(flat);
+    flatCopy[16] = 99;
+    bool copyOk = flatCopy.size() == 16 && flatCopy.find(16)->second == 99;
+    std::cout << "flat copy after erase: " << (copyOk ? "ok" : "FAILED") << std::endl;
+    if(!copyOk)
+        return 1;
+
     return 0;
 }